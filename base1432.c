@@ -21,6 +21,7 @@
 #endif
 
 #include "binary.h"
+#include "simd.h"
 
 typedef union {
 	uint8_t buf[4];
@@ -43,6 +44,10 @@ int base16384_encode_safe(const char* data, int dlen, char* buf) {
 	uint32_t* vals = (uint32_t*)buf;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_encode_simd(data, dlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i < dlen - 7; i += 7) {
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(*(uint32_t*)(data+i));
@@ -140,6 +145,10 @@ int base16384_encode(const char* data, int dlen, char* buf) {
 	uint32_t* vals = (uint32_t*)buf;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_encode_simd(data, dlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i <= dlen - 7; i += 7) {
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(*(uint32_t*)(data+i));
@@ -215,6 +224,10 @@ int base16384_encode_unsafe(const char* data, int dlen, char* buf) {
 	uint32_t* vals = (uint32_t*)buf;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_encode_simd(data, dlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i < dlen; i += 7) {
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(*(uint32_t*)(data+i));
@@ -259,6 +272,10 @@ int base16384_decode_safe(const char* data, int dlen, char* buf) {
 	const uint32_t* vals = (const uint32_t*)data;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_decode_simd(data, outlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i < outlen - 7; i+=7) {	// n += 2 in one loop
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(vals[n++]) - 0x4e004e00;
@@ -356,6 +373,10 @@ int base16384_decode(const char* data, int dlen, char* buf) {
 	const uint32_t* vals = (const uint32_t*)data;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_decode_simd(data, outlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i <= outlen - 7; i+=7) {	// n += 2 in one loop
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(vals[n++]) - 0x4e004e00;
@@ -433,6 +454,10 @@ int base16384_decode_unsafe(const char* data, int dlen, char* buf) {
 	const uint32_t* vals = (const uint32_t*)data;
 	uint32_t n = 0;
 	int32_t i = 0;
+	#ifdef BASE16384_SIMD
+		i = (int32_t)_base16384_decode_simd(data, outlen / 7, buf) * 7;
+		n = (uint32_t)i / 7 * 2;
+	#endif
 	for(; i < outlen-7; i+=7) {	// n += 2 in one loop
 		register uint32_t sum = 0;
 		register uint32_t shift = htobe32(vals[n++]) - 0x4e004e00;
@@ -21,6 +21,7 @@
 #endif
 
 #include "binary.h"
+#include "simd.h"
 
 typedef union {
 	uint8_t buf[8];
@@ -43,6 +44,10 @@ int base16384_encode_safe(const char* data, int dlen, char* buf) {
 	uint64_t* vals = (uint64_t*)buf;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_encode_simd(data, dlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i < dlen - 7; i += 7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(*(uint64_t*)(data+i))>>2;
@@ -125,6 +130,10 @@ int base16384_encode(const char* data, int dlen, char* buf) {
 	uint64_t* vals = (uint64_t*)buf;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_encode_simd(data, dlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i <= dlen - 7; i += 7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(*(uint64_t*)(data+i))>>2; // here comes a read overlap
@@ -190,6 +199,10 @@ int base16384_encode_unsafe(const char* data, int dlen, char* buf) {
 	uint64_t* vals = (uint64_t*)buf;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_encode_simd(data, dlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i < dlen; i += 7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(*(uint64_t*)(data+i))>>2; // here comes a read overlap
@@ -230,6 +243,10 @@ int base16384_decode_safe(const char* data, int dlen, char* buf) {
 	const uint64_t* vals = (const uint64_t*)data;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_decode_simd(data, outlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i < outlen - 7; n++, i+=7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(vals[n]) - 0x4e004e004e004e00;
@@ -307,6 +324,10 @@ int base16384_decode(const char* data, int dlen, char* buf) {
 	const uint64_t* vals = (const uint64_t*)data;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_decode_simd(data, outlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i <= outlen - 7; n++, i+=7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(vals[n]) - 0x4e004e004e004e00;
@@ -371,6 +392,10 @@ int base16384_decode_unsafe(const char* data, int dlen, char* buf) {
 	const uint64_t* vals = (const uint64_t*)data;
 	uint64_t n = 0;
 	int64_t i = 0;
+	#ifdef BASE16384_SIMD
+		n = _base16384_decode_simd(data, outlen / 7, buf);
+		i = (int64_t)n * 7;
+	#endif
 	for(; i < outlen-7; n++, i+=7) {
 		register uint64_t sum = 0;
 		register uint64_t shift = htobe64(vals[n]) - 0x4e004e004e004e00;
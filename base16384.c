@@ -19,8 +19,10 @@
 #ifndef __cosmopolitan
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
 #ifdef _WIN32
 	#include <windows.h>
 #endif
@@ -52,25 +54,164 @@ static base16384_err_t print_usage() {
 			BASE16384_VERSION_DATE
 		"). Usage:\n", stderr
 	);
-	fputs("base16384 -[ed][t][n][cC] [inputfile] [outputfile]\n", stderr);
+	fputs("base16384 [-j N|auto] [--bufsize N[K|M]|auto] [--range off:len] -[ed][x][i][t][n][u][cC][kK] [inputfile] [outputfile]\n", stderr);
+	fputs("  -j\t\tcode files or stdin/stdout by N threads or all usable cpus\n", stderr);
+	fputs("  --bufsize\tread N bytes at a time or tune it for the files\n", stderr);
+	fputs("  --range\tdecode len bytes from off only, reading the groups covering them\n", stderr);
 	fputs("  -e\t\tencode (default)\n", stderr);
 	fputs("  -d\t\tdecode\n", stderr);
+	fputs("  -x\t\tencode into or decode from a seekable container of checksummed chunks\n", stderr);
+	fputs("  -i\t\tinspect the header and the index of a container\n", stderr);
 	fputs("  -t\t\tshow spend time\n", stderr);
 	fputs("  -n\t\tdonot write utf16be file header (0xFEFF)\n", stderr);
+	fputs("  -u\t\twrite or read utf8 instead of utf16be\n", stderr);
 	fputs("  -c\t\tembed or validate checksum in remainder\n", stderr);
 	fputs("  -C\t\tdo -c forcely\n", stderr);
+	fputs("  -k\t\tappend or validate a crc32c trailer\n", stderr);
+	fputs("  -K\t\tdo -k by a tree of blocks, which -j hashes in parallel\n", stderr);
 	fputs("  inputfile\tpass - to read from stdin\n", stderr);
 	fputs("  outputfile\tpass - to write to stdout\n", stderr);
 	return base16384_err_invalid_commandline_parameter;
 }
 
+// parse N, NK or NM, 0 on error
+static size_t parse_bufsize(const char* s) {
+	char* end;
+	unsigned long n = strtoul(s, &end, 10);
+	if(*end == 'K' || *end == 'k') { n <<= 10; end++; }
+	else if(*end == 'M' || *end == 'm') { n <<= 20; end++; }
+	return (end == s || *end || n > (1ul<<30))?0:(size_t)n;
+}
+
+// parse off:len, -1 on error
+static int parse_range(const char* s, unsigned long long* off, unsigned long long* len) {
+	char* end;
+	*off = strtoull(s, &end, 10);
+	if(end == s || *end++ != ':') return -1;
+	s = end;
+	*len = strtoull(s, &end, 10);
+	return (end == s || *end)?-1:0;
+}
+
+#ifdef _MSC_VER
+	#define fileno _fileno
+#endif
+
+// decode a range of the seekable input into output by chunks of bufsize bytes
+static base16384_err_t decode_range(const char* input, const char* output, unsigned long long off, unsigned long long len, char* buf, size_t bufsize, int flag) {
+	if(!strcmp(input, "-")) return print_usage();
+	FILE* fp = fopen(input, "rb");
+	if(!fp) return base16384_err_open_input_file;
+	FILE* fpo = strcmp(output, "-")?fopen(output, "wb"):stdout;
+	if(!fpo) {
+		fclose(fp);
+		return base16384_err_fopen_output_file;
+	}
+	base16384_err_t err = base16384_err_ok;
+	while(len) {
+		ssize_t n = base16384_decode_range(fileno(fp), (off_t)off, (len > bufsize)?bufsize:(size_t)len, buf, flag);
+		if(n < 0) {
+			err = base16384_err_read_file;
+			break;
+		}
+		if(!n) break;
+		if(fwrite(buf, n, 1, fpo) != 1) {
+			err = base16384_err_write_file;
+			break;
+		}
+		off += n;
+		len -= n;
+	}
+	fclose(fp);
+	if(fpo != stdout) fclose(fpo);
+	else fflush(stdout);
+	return err;
+}
+
+#ifndef _WIN32
+// open the input and the output files as descriptors, where `-` is stdin or stdout
+#define open_container_files(fp, fpo, outmode) \
+	FILE* fp = strcmp(input, "-")?fopen(input, "rb"):stdin; \
+	if(!fp) return base16384_err_open_input_file; \
+	FILE* fpo = strcmp(output, "-")?fopen(output, outmode):stdout; \
+	if(!fpo) { \
+		if(fp != stdin) fclose(fp); \
+		return base16384_err_fopen_output_file; \
+	}
+
+#define close_container_files(fp, fpo) \
+	if(fp != stdin) fclose(fp); \
+	if(fpo != stdout) fclose(fpo); \
+	else fflush(stdout);
+
+// the container is written as one CRC32C-checked chunk after another
+static base16384_err_t code_container(const char* input, const char* output, int is_encode, int flag, int threads) {
+	open_container_files(fp, fpo, "wb");
+	int64_t bad;
+	base16384_err_t err = is_encode
+		?base16384_encode_container(fileno(fp), fileno(fpo), flag|BASE16384_FLAG_CRC32C, 0)
+		:base16384_decode_container(fileno(fp), fileno(fpo), threads, &bad);
+	if(!is_encode && bad >= 0) fprintf(stderr, "chunk %lld is damaged\n", (long long)bad);
+	close_container_files(fp, fpo);
+	return err;
+}
+
+static base16384_err_t inspect_container(const char* input, const char* output) {
+	open_container_files(fp, fpo, "w");
+	base16384_container_t c;
+	base16384_err_t err = base16384_err_ok;
+	if(base16384_container_open(fileno(fp), &c)) err = (errno == EBADMSG)?base16384_err_invalid_container:base16384_err_read_file;
+	else {
+		uint64_t i;
+		fprintf(fpo, "length: %llu\nchunk: %lu\nchecksum: %s\nchunks: %llu\n",
+			(unsigned long long)c.length, (unsigned long)c.chunk,
+			(c.checksum == BASE16384_CONTAINER_CRC32C)?"crc32c":"none", (unsigned long long)c.count);
+		for(i = 0; i < c.count; i++) {
+			fprintf(fpo, "%llu\t%llu\t%08x\n", (unsigned long long)i,
+				(unsigned long long)(c.base + c.offsets[i]), (unsigned int)c.checksums[i]);
+		}
+		base16384_container_close(&c);
+	}
+	close_container_files(fp, fpo);
+	return err;
+}
+#endif
+
+// let base16384_get_bufsize look at the files, which the coder opens again later
+static size_t get_bufsize(const char* input, const char* output) {
+	FILE* fp = strcmp(input, "-")?fopen(input, "rb"):stdin;
+	FILE* fpo = strcmp(output, "-")?fopen(output, "rb"):stdout;	// no new output yet
+	size_t bufsize = base16384_get_bufsize(fp?fileno(fp):-1, fpo?fileno(fpo):-1);
+	if(fp && fp != stdin) fclose(fp);
+	if(fpo && fpo != stdout) fclose(fpo);
+	return bufsize;
+}
+
 int main(int argc, char** argv) {
 
+	int threads = 1, auto_bufsize = 0, use_range = 0;
+	size_t bufsize = BASE16384_BUFSZ;
+	unsigned long long range_off = 0, range_len = 0;
+	while(argc > 4) {
+		if(!strcmp(argv[1], "-j")) {
+			threads = strcmp(argv[2], "auto")?atoi(argv[2]):base16384_get_nproc();
+			if(threads <= 0) return print_usage();
+		} else if(!strcmp(argv[1], "--bufsize")) {
+			auto_bufsize = !strcmp(argv[2], "auto");
+			if(!auto_bufsize && !(bufsize = parse_bufsize(argv[2]))) return print_usage();
+		} else if(!strcmp(argv[1], "--range")) {
+			use_range = 1;
+			if(parse_range(argv[2], &range_off, &range_len)) return print_usage();
+		} else return print_usage();
+		argc -= 2;
+		argv += 2;
+	}
+
 	const char* cmd = argv[1];
 	if(argc != 4 || cmd[0] != '-') return print_usage();
 
 	int flaglen = strlen(cmd);
-	if(flaglen <= 1 || flaglen > 5) return print_usage();
+	if(flaglen <= 1 || flaglen > 9) return print_usage();
 
 	#ifdef _WIN32
 		clock_t t = 0;
@@ -78,7 +219,7 @@ int main(int argc, char** argv) {
 		unsigned long t = 0;
 	#endif
 
-	uint16_t is_encode = 1, use_timer = 0, no_header = 0, use_checksum = 0;
+	uint16_t is_encode = 1, use_timer = 0, no_header = 0, use_checksum = 0, use_crc = 0, use_container = 0, use_utf8 = 0;
 	#define set_flag(f, v) ((f) = (((((f)>>8)+1) << 8)&0xff00) | (v&0x00ff))
 	#define flag_has_been_set(f) ((f)>>8)
 	#define set_or_test_flag(f, v) (flag_has_been_set(f)?1:(set_flag(f, v), 0))
@@ -101,6 +242,21 @@ int main(int argc, char** argv) {
 		case 'C':
 			if(set_or_test_flag(use_checksum, 2)) return print_usage();
 		break;
+		case 'x':
+			if(set_or_test_flag(use_container, 1)) return print_usage();
+		break;
+		case 'i':
+			if(set_or_test_flag(use_container, 2)) return print_usage();
+		break;
+		case 'k':
+			if(set_or_test_flag(use_crc, 1)) return print_usage();
+		break;
+		case 'K':
+			if(set_or_test_flag(use_crc, 2)) return print_usage();
+		break;
+		case 'u':
+			if(set_or_test_flag(use_utf8, 1)) return print_usage();
+		break;
 		default:
 			return print_usage();
 		break;
@@ -108,6 +264,8 @@ int main(int argc, char** argv) {
 	#define clear_high_byte(x) ((x) &= 0x00ff)
 	clear_high_byte(is_encode); clear_high_byte(use_timer);
 	clear_high_byte(no_header); clear_high_byte(use_checksum);
+	clear_high_byte(use_crc); clear_high_byte(use_container);
+	clear_high_byte(use_utf8);
 
 	if(use_timer) {
 		#ifdef _WIN32
@@ -119,14 +277,43 @@ int main(int argc, char** argv) {
 
 	base16384_err_t exitstat = base16384_err_ok;
 
-	#define do_coding(method) base16384_##method##_file_detailed( \
-		argv[2], argv[3], encbuf, decbuf, \
-		(no_header?BASE16384_FLAG_NOHEADER:0) \
-		| ((use_checksum&1)?BASE16384_FLAG_SUM_CHECK_ON_REMAIN:0) \
-		| ((use_checksum&2)?BASE16384_FLAG_DO_SUM_CHECK_FORCELY:0) \
+	if(auto_bufsize) bufsize = get_bufsize(argv[2], argv[3]);
+	char *ebuf = encbuf, *dbuf = decbuf;
+	if(bufsize > BASE16384_BUFSZ) { // the static buffers fit no more
+		ebuf = (char*)malloc(base16384_encbuf_len(bufsize));
+		dbuf = (char*)malloc(base16384_decbuf_len(bufsize));
+		if(!ebuf || !dbuf) {
+			if(ebuf) free(ebuf);
+			if(dbuf) free(dbuf);
+			ebuf = encbuf; dbuf = decbuf;
+			bufsize = BASE16384_BUFSZ;
+		}
+	}
+
+	int flag = (no_header?BASE16384_FLAG_NOHEADER:0)
+		| ((use_checksum&1)?BASE16384_FLAG_SUM_CHECK_ON_REMAIN:0)
+		| ((use_checksum&2)?BASE16384_FLAG_DO_SUM_CHECK_FORCELY:0)
+		| ((use_crc&1)?BASE16384_FLAG_CRC32C:0)
+		| ((use_crc&2)?BASE16384_FLAG_CRC_TREE:0)
+		| (use_utf8?BASE16384_FLAG_UTF8:0);
+
+	#define do_coding(method) base16384_##method##_file_parallel_ex( \
+		argv[2], argv[3], ebuf, dbuf, flag, threads, bufsize \
 	)
-		exitstat = is_encode?do_coding(encode):do_coding(decode);
+		if((use_container || use_range) && use_utf8) exitstat = print_usage();	// both seek in utf16be
+		else if(use_container) {
+			#ifdef _WIN32
+				exitstat = print_usage();
+			#else
+				exitstat = (use_container&2)?inspect_container(argv[2], argv[3]):code_container(argv[2], argv[3], is_encode, flag, threads);
+			#endif
+		} else if(use_range) exitstat = is_encode?print_usage():decode_range(argv[2], argv[3], range_off, range_len, ebuf, bufsize, flag);
+		else exitstat = is_encode?do_coding(encode):do_coding(decode);
 	#undef do_coding
+	if(ebuf != encbuf) {
+		free(ebuf);
+		free(dbuf);
+	}
 	if(t) {
 		#ifdef _WIN32
 			fprintf(stderr, "spend time: %lums\n", clock() - t);
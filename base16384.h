@@ -22,6 +22,9 @@
 #ifndef __cosmopolitan
 #include <stdint.h>
 #include <stdio.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 #endif
 #ifdef _MSC_VER
 #include <BaseTsd.h>
@@ -42,6 +45,7 @@ enum base16384_err_t {
 	base16384_err_invalid_file_name,
 	base16384_err_invalid_commandline_parameter,
 	base16384_err_invalid_decoding_checksum,
+	base16384_err_invalid_container,
 };
 /**
  * @brief return value of base16384_en/decode_file
@@ -52,11 +56,19 @@ typedef enum base16384_err_t base16384_err_t;
 	#define BASE16384_BUFSZ_FACTOR (8)
 #endif
 
+#ifndef BASE16384_BUFSZ_MAX
+	#define BASE16384_BUFSZ_MAX ((size_t)4<<20)
+#endif
+
 #define _BASE16384_ENCBUFSZ ((BUFSIZ*BASE16384_BUFSZ_FACTOR)/7*7)
 #define _BASE16384_DECBUFSZ ((BUFSIZ*BASE16384_BUFSZ_FACTOR)/8*8)
 
 #define BASE16384_ENCBUFSZ (_BASE16384_ENCBUFSZ+16)
-#define BASE16384_DECBUFSZ (_BASE16384_DECBUFSZ+16)
+// decbuf also receives the encoding of a full encbuf, which is larger than _BASE16384_DECBUFSZ
+#define BASE16384_DECBUFSZ (_BASE16384_ENCBUFSZ/7*8+16)
+
+// the default bufsize of base16384_en/decode_xxx_ex, which BASE16384_ENCBUFSZ and BASE16384_DECBUFSZ fit
+#define BASE16384_BUFSZ (BUFSIZ*BASE16384_BUFSZ_FACTOR)
 
 // disable 0xFEFF file header in encode
 #define BASE16384_FLAG_NOHEADER				(1<<0)
@@ -64,6 +76,22 @@ typedef enum base16384_err_t base16384_err_t;
 #define BASE16384_FLAG_SUM_CHECK_ON_REMAIN	(1<<1)
 // forcely do sumcheck without checking data length
 #define BASE16384_FLAG_DO_SUM_CHECK_FORCELY	(1<<2)
+// append the CRC32C of the data after the `=` remainder and verify it in decode
+#define BASE16384_FLAG_CRC32C				(1<<3)
+
+// append the CRC32C of the CRC32Cs of every BASE16384_CRC_TREE_BLOCK bytes instead, which threads can verify
+#define BASE16384_FLAG_CRC_TREE				(1<<4)
+
+// write the code units as UTF-8 instead of UTF-16BE, 3 bytes each, with EF BB BF as the header
+#define BASE16384_FLAG_UTF8					(1<<5)
+
+// the length of the BASE16384_FLAG_CRC32C or BASE16384_FLAG_CRC_TREE trailer, which is the coding of the big endian CRC32C
+#define BASE16384_CRC32C_TRAILER_LEN (8)
+
+// the data bytes hashed into one leaf of BASE16384_FLAG_CRC_TREE, whole groups
+#ifndef BASE16384_CRC_TREE_BLOCK
+	#define BASE16384_CRC_TREE_BLOCK ((size_t)7<<16)
+#endif
 
 /**
  * @brief custom reader function interface
@@ -213,6 +241,447 @@ int base16384_decode(const char* data, int dlen, char* buf);
 */
 int base16384_decode_unsafe(const char* data, int dlen, char* buf);
 
+/**
+ * @brief safely decode data like `base16384_decode_safe` but reject
+ *        code units out of U+4E00..U+8DFF and malformed `=` remainder
+ * @param data data to decode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_decode_len`
+ * @param errpos store the byte offset of the first invalid code unit, can be NULL
+ * @return the total length written or -1 on invalid data
+*/
+int base16384_decode_strict(const char* data, int dlen, char* buf, int* errpos);
+
+/**
+ * @brief calculate the size of the UTF-8 of UTF-16BE code, 3 bytes for every code unit
+ * @param len the UTF-16BE length
+ * @return the size
+*/
+static inline int base16384_utf8_len(int len) {
+	return len / 2 * 3;
+}
+
+/**
+ * @brief calculate the exact UTF-8 encoded size
+ * @param dlen the data length to encode
+ * @return the size
+*/
+static inline int _base16384_encode_utf8_len(int dlen) {
+	return base16384_utf8_len(_base16384_encode_len(dlen));
+}
+
+/**
+ * @brief safely encode data into UTF-8 instead of UTF-16BE in one pass
+ * @param data data to encode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_encode_utf8_len`
+ * @return the total length written
+*/
+int base16384_encode_utf8(const char* data, int dlen, char* buf);
+
+/**
+ * @brief safely decode the UTF-8 of base16384_encode_utf8 in one pass like `base16384_decode_safe`
+ * @param data data to decode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_decode_len` of `dlen/3*2`
+ * @return the total length written
+*/
+int base16384_decode_utf8(const char* data, int dlen, char* buf);
+
+/**
+ * @brief calculate the exact encoded size of any length
+ * @param dlen the data length to encode
+ * @return the size or SIZE_MAX on overflow
+*/
+static inline size_t _base16384_encode_len64(size_t dlen) {
+	static const int remain[7] = {0, 4, 6, 6, 8, 8, 10};	// also count 0x3dxx
+	if(dlen / 7 > (SIZE_MAX - 32) / 8) return SIZE_MAX;
+	return dlen / 7 * 8 + remain[dlen % 7];
+}
+
+/**
+ * @brief calculate minimum encoding buffer size of any length like `base16384_encode_len`
+ * @param dlen the data length to encode
+ * @return the size or SIZE_MAX on overflow
+*/
+static inline size_t base16384_encode_len64(size_t dlen) {
+	size_t outlen = _base16384_encode_len64(dlen);
+	return (outlen == SIZE_MAX)?SIZE_MAX:(outlen + 16);
+}
+
+/**
+ * @brief calculate the exact decoded size of any length
+ * @param dlen the data length to decode
+ * @param offset the last char `xx` of the underfilled coding (0x3Dxx) or 0 for the full coding
+ * @return the size
+*/
+static inline size_t _base16384_decode_len64(size_t dlen, int offset) {
+	static const int remain[7] = {0, 4, 6, 6, 8, 8, 10};	// also count 0x3dxx
+	if(offset > 0 && offset < 7) dlen = (dlen > (size_t)remain[offset])?(dlen - remain[offset]):0;
+	else offset = 0;
+	return dlen / 8 * 7 + offset;
+}
+
+/**
+ * @brief calculate minimum decoding buffer size of any length like `base16384_decode_len`
+ * @param dlen the data length to decode
+ * @param offset the last char `xx` of the underfilled coding (0x3Dxx) or 0 for the full coding
+ * @return the size or SIZE_MAX on overflow
+*/
+static inline size_t base16384_decode_len64(size_t dlen, int offset) {
+	size_t outlen = _base16384_decode_len64(dlen, offset);
+	return (outlen > SIZE_MAX - 16)?SIZE_MAX:(outlen + 16);
+}
+
+/*
+ * The *64 variants below take buffers of any length, feeding the kernels with
+ * 1 GiB chunks of whole groups, so they run as fast as the int ones.
+*/
+
+/**
+ * @brief safely encode data of any length like `base16384_encode_safe`
+ * @param data data to encode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_encode_len64`
+ * @return the total length written
+*/
+size_t base16384_encode_safe64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief encode data of any length like `base16384_encode`
+ * @param data data to encode
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must greater than `base16384_encode_len64`
+ * @return the total length written
+*/
+size_t base16384_encode64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief encode data of any length like `base16384_encode_unsafe`
+ * @param data data to encode
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must greater than `base16384_encode_len64`
+ * @return the total length written
+*/
+size_t base16384_encode_unsafe64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief safely decode data of any length like `base16384_decode_safe`
+ * @param data data to decode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_decode_len64`
+ * @return the total length written
+*/
+size_t base16384_decode_safe64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief decode data of any length like `base16384_decode`
+ * @param data data to decode
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must greater than `base16384_decode_len64`
+ * @return the total length written
+*/
+size_t base16384_decode64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief decode data of any length like `base16384_decode_unsafe`
+ * @param data data to decode
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must greater than `base16384_decode_len64`
+ * @return the total length written
+*/
+size_t base16384_decode_unsafe64(const char* data, size_t dlen, char* buf);
+
+/**
+ * @brief safely decode data of any length like `base16384_decode_strict`
+ * @param data data to decode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size can be exactly `_base16384_decode_len64`
+ * @param errpos store the byte offset of the first invalid code unit, can be NULL
+ * @return the total length written or -1 on invalid data
+*/
+ssize_t base16384_decode_strict64(const char* data, size_t dlen, char* buf, size_t* errpos);
+
+/**
+ * @brief calculate the exact output size of `base16384_encode_batch`
+ * @param offsets the n+1 offsets of the items in data, like Arrow
+ * @param n the count of items
+ * @return the size
+*/
+int base16384_encode_batch_len(const int* offsets, int n);
+
+/**
+ * @brief encode many items into one contiguous buffer, each one like `base16384_encode_safe`,
+ *        coding the full groups and the remainders of many items by one kernel call
+ * @param data the items to encode, no data overread
+ * @param offsets the n+1 offsets of the items in data, like Arrow
+ * @param n the count of items
+ * @param buf the output buffer, whose size can be exactly `base16384_encode_batch_len`
+ * @param outoffsets where to put the n+1 offsets of the encoded items in buf
+ * @return the total length written
+*/
+int base16384_encode_batch(const char* data, const int* offsets, int n, char* buf, int* outoffsets);
+
+/**
+ * @brief encode n items of width bytes each into n items of `_base16384_encode_len(width)` bytes
+ * @param data the items to encode, no data overread
+ * @param width the length of each item
+ * @param n the count of items
+ * @param buf the output buffer, whose size can be exactly `n*_base16384_encode_len(width)`
+ * @return the total length written
+*/
+int base16384_encode_batch_fixed(const char* data, int width, int n, char* buf);
+
+/**
+ * @brief calculate the maximum output size of `base16384_decode_batch`
+ * @param data the items to decode
+ * @param offsets the n+1 offsets of the items in data, like Arrow
+ * @param n the count of items
+ * @return the size
+*/
+int base16384_decode_batch_len(const char* data, const int* offsets, int n);
+
+/**
+ * @brief decode many items into one contiguous buffer, each one like `base16384_decode_strict`
+ * @param data the items to decode, no data overread
+ * @param offsets the n+1 offsets of the items in data, like Arrow
+ * @param n the count of items
+ * @param buf the output buffer, whose size can be exactly `base16384_decode_batch_len`
+ * @param outoffsets where to put the n+1 offsets of the decoded items in buf, where invalid ones are empty
+ * @param validity the (n+7)/8 bytes bitmap where bit i (LSB first) is set if item i is valid
+ * @return the count of valid items
+*/
+int base16384_decode_batch(const char* data, const int* offsets, int n, char* buf, int* outoffsets, uint8_t* validity);
+
+/**
+ * @brief decode n items of `_base16384_encode_len(width)` bytes each into n items of width bytes
+ * @param data the items to decode, no data overread
+ * @param width the length of each decoded item
+ * @param n the count of items
+ * @param buf the output buffer of `n*width` bytes, where invalid items are zeroed
+ * @param validity the (n+7)/8 bytes bitmap where bit i (LSB first) is set if item i is valid
+ * @return the count of valid items
+*/
+int base16384_decode_batch_fixed(const char* data, int width, int n, char* buf, uint8_t* validity);
+
+/**
+ * @brief update a CRC32C (Castagnoli) with SSE4.2 if the cpu and the kernel allow, or by slice-by-8 tables
+ * @param crc the CRC32C of the data before, 0 for none
+ * @param data the data to add
+ * @param len the data length
+ * @return the CRC32C of all the data
+*/
+uint32_t base16384_crc32c(uint32_t crc, const char* data, size_t len);
+
+/**
+ * @brief calculate the leaves of BASE16384_FLAG_CRC_TREE, the CRC32C of every BASE16384_CRC_TREE_BLOCK bytes
+ * @param data the data
+ * @param len the data length
+ * @param leaves the output of `(len+BASE16384_CRC_TREE_BLOCK-1)/BASE16384_CRC_TREE_BLOCK` leaves
+ * @return the count of leaves
+*/
+size_t base16384_crc_tree_leaves(const char* data, size_t len, uint32_t* leaves);
+
+/**
+ * @brief combine the leaves into the root digest in the BASE16384_FLAG_CRC_TREE trailer
+ * @param leaves the leaves in order
+ * @param n the count of leaves
+ * @return the CRC32C of the big endian leaves
+*/
+uint32_t base16384_crc_tree_root(const uint32_t* leaves, size_t n);
+
+/**
+ * @brief get the kernel used by base16384_en/decode*, which is the fastest one
+ *        supported by the cpu unless overridden by env `BASE16384_FORCE_IMPL`
+ * @return the kernel name like `avx2`, `sse4.1`, `bmi2` or `generic`
+*/
+const char* base16384_get_impl();
+
+/**
+ * @brief switch the kernel used by base16384_en/decode* for benchmarking
+ * @param name the kernel name or NULL to select the fastest one
+ * @return 0 on success or -1 if the kernel is unknown or unsupported by the cpu
+*/
+int base16384_set_impl(const char* name);
+
+struct base16384_encoder_t {
+	char remain[7];		// the underfilled group left by last update
+	int remain_len;
+	uint32_t sum;		// running sum of BASE16384_FLAG_SUM_CHECK_ON_REMAIN
+	uint32_t crc;		// running CRC32C of BASE16384_FLAG_CRC32C or of the current leaf
+	uint32_t root;		// running CRC32C of the full leaves of BASE16384_FLAG_CRC_TREE
+	size_t leaf_len;	// the data length in the current leaf
+	int flag;
+	int header_pending;
+};
+/**
+ * @brief state of a push-style incremental encoder
+*/
+typedef struct base16384_encoder_t base16384_encoder_t;
+
+/**
+ * @brief calculate the maximum size that one base16384_encoder_update could write,
+ *        which is `base16384_utf8_len` of it for BASE16384_FLAG_UTF8
+ * @param dlen the data length to update
+ * @return the size
+*/
+static inline int base16384_encoder_update_len(int dlen) {
+	return (dlen + 6) / 7 * 8 + 2;	// an underfilled group may be completed and a header may be written
+}
+
+// the maximum size that base16384_encoder_final could write, also as UTF-8
+#define BASE16384_ENCODER_FINAL_LEN ((12+BASE16384_CRC32C_TRAILER_LEN)/2*3)
+
+/**
+ * @brief initialize an incremental encoder
+ * @param enc the encoder state
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+*/
+void base16384_encoder_init(base16384_encoder_t* enc, int flag);
+
+/**
+ * @brief encode a chunk of any size, keeping its underfilled group for the next call
+ * @param enc the encoder state
+ * @param data data to encode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must be no less than `base16384_encoder_update_len`
+ * @return the total length written
+*/
+int base16384_encoder_update(base16384_encoder_t* enc, const char* data, int dlen, char* buf);
+
+/**
+ * @brief encode the underfilled group with its `=` remainder and the optional checksum
+ * @param enc the encoder state, which must be initialized again before reuse
+ * @param buf the output buffer, whose size must be no less than BASE16384_ENCODER_FINAL_LEN
+ * @return the total length written
+*/
+int base16384_encoder_final(base16384_encoder_t* enc, char* buf);
+
+struct base16384_decoder_t {
+	char remain[32];	// the tail held back by last update, which may contain the `=` remainder and the CRC32C trailer
+	int remain_len;
+	uint32_t sum;		// running sum of BASE16384_FLAG_SUM_CHECK_ON_REMAIN
+	uint32_t crc;		// running CRC32C of BASE16384_FLAG_CRC32C or of the current leaf
+	uint32_t root;		// running CRC32C of the full leaves of BASE16384_FLAG_CRC_TREE
+	size_t leaf_len;	// the data length in the current leaf
+	size_t total;		// the total length decoded
+	int flag;
+	int header_pending;
+};
+/**
+ * @brief state of a push-style incremental decoder
+*/
+typedef struct base16384_decoder_t base16384_decoder_t;
+
+/**
+ * @brief calculate the maximum size that one base16384_decoder_update could write
+ * @param dlen the data length to update
+ * @return the size
+*/
+static inline int base16384_decoder_update_len(int dlen) {
+	return (dlen + 10) / 8 * 7;	// at most 10 bytes are held back by the last update
+}
+
+// the maximum size that base16384_decoder_final could write
+#define BASE16384_DECODER_FINAL_LEN (14)
+
+/**
+ * @brief initialize an incremental decoder
+ * @param dec the decoder state
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+*/
+void base16384_decoder_init(base16384_decoder_t* dec, int flag);
+
+/**
+ * @brief decode a chunk of any size, which can be split anywhere, even inside a
+ *        code unit or the `=` remainder. The leading 0xFEFF is skipped.
+ * @param dec the decoder state
+ * @param data data to decode, no data overread
+ * @param dlen the data length
+ * @param buf the output buffer, whose size must be no less than `base16384_decoder_update_len`
+ * @return the total length written
+*/
+int base16384_decoder_update(base16384_decoder_t* dec, const char* data, int dlen, char* buf);
+
+/**
+ * @brief decode the held back tail and verify the optional checksum
+ * @param dec the decoder state, which must be initialized again before reuse
+ * @param buf the output buffer, whose size must be no less than BASE16384_DECODER_FINAL_LEN
+ * @return the total length written or -1 with errno EINVAL on checksum mismatch
+*/
+int base16384_decoder_final(base16384_decoder_t* dec, char* buf);
+
+/**
+ * @brief calculate minimum encbuf size of base16384_en/decode_xxx_ex
+ * @param bufsize the bytes read at a time
+ * @return the size, which is BASE16384_ENCBUFSZ for BASE16384_BUFSZ
+*/
+static inline size_t base16384_encbuf_len(size_t bufsize) {
+	return bufsize / 7 * 7 + 16;
+}
+
+/**
+ * @brief calculate minimum decbuf size of base16384_en/decode_xxx_ex
+ * @param bufsize the bytes read at a time
+ * @return the size, which is BASE16384_DECBUFSZ for BASE16384_BUFSZ
+*/
+static inline size_t base16384_decbuf_len(size_t bufsize) {
+	return bufsize / 7 * 8 + 16;
+}
+
+/**
+ * @brief tune the bufsize of base16384_en/decode_xxx_ex for the files, so that encbuf
+ *        and decbuf stay in the L2 cache, a pipe takes a whole chunk at a time and
+ *        a regular file or block device is read and written by whole blocks
+ * @param input input file descripter or -1 if unknown
+ * @param output output file descripter or -1 if unknown
+ * @return the bufsize, between BUFSIZ and BASE16384_BUFSZ_MAX
+*/
+size_t base16384_get_bufsize(int input, int output);
+
+struct base16384_allocator_t {
+	void* (*alloc)(void* opaque, size_t size, size_t align);
+	void (*free)(void* opaque, void* ptr, size_t size);
+	void* opaque;
+};
+/**
+ * @brief custom allocator hook of base16384_ctx_t
+*/
+typedef struct base16384_allocator_t base16384_allocator_t;
+
+// back the buffers of base16384_ctx_t by huge pages if possible
+#define BASE16384_CTX_HUGEPAGE (1<<0)
+
+struct base16384_ctx_t {
+	char *encbuf, *decbuf;	// cache line aligned, sized for bufsize
+	size_t bufsize;
+	void* mem;		// the block holding both buffers
+	size_t memlen;
+	int mapped;		// mem is mapped rather than allocated
+	base16384_allocator_t allocator;
+};
+/**
+ * @brief the buffers reused by base16384_en/decode_xxx_ctx, which
+ *        can be used by only one thread at a time, e.g. one per thread
+*/
+typedef struct base16384_ctx_t base16384_ctx_t;
+
+/**
+ * @brief allocate the buffers of a context
+ * @param ctx the context
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, 0 for BASE16384_BUFSZ
+ * @param flag BASE16384_CTX_xxx value, add multiple flags by `|`
+ * @param allocator the allocator to use or NULL for the default one, which is copied
+ * @return 0 on success or -1 with errno ENOMEM
+*/
+int base16384_ctx_init(base16384_ctx_t* ctx, size_t bufsize, int flag, const base16384_allocator_t* allocator);
+
+/**
+ * @brief free the buffers of a context
+ * @param ctx the context, which must be initialized again before reuse
+*/
+void base16384_ctx_free(base16384_ctx_t* ctx);
+
 #define base16384_typed_params(type) type input, type output, char* encbuf, char* decbuf
 #define base16384_typed_flag_params(type) base16384_typed_params(type), int flag
 
@@ -304,6 +773,321 @@ base16384_err_t base16384_decode_fd_detailed(base16384_typed_flag_params(int));
 */
 base16384_err_t base16384_decode_stream_detailed(base16384_typed_flag_params(base16384_stream_t*));
 
+/**
+ * @brief encode input file to output file like `base16384_encode_file_detailed`, reading bufsize bytes at a time
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_encode_file_ex(base16384_typed_flag_params(const char*), size_t bufsize);
+
+/**
+ * @brief encode input `FILE*` to output `FILE*` like `base16384_encode_fp_detailed`, reading bufsize bytes at a time
+ * @param input `FILE*` pointer
+ * @param output `FILE*` pointer
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_encode_fp_ex(base16384_typed_flag_params(FILE*), size_t bufsize);
+
+/**
+ * @brief encode input stream to output stream like `base16384_encode_fd_detailed`, reading bufsize bytes at a time
+ * @param input file descripter
+ * @param output file descripter
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_encode_fd_ex(base16384_typed_flag_params(int), size_t bufsize);
+
+/**
+ * @brief encode custom input reader to custom output writer like `base16384_encode_stream_detailed`, reading bufsize bytes at a time
+ * @param input custom input reader
+ * @param output custom output writer
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_encode_stream_ex(base16384_typed_flag_params(base16384_stream_t*), size_t bufsize);
+
+/**
+ * @brief decode input file to output file like `base16384_decode_file_detailed`, reading bufsize bytes at a time
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_decode_file_ex(base16384_typed_flag_params(const char*), size_t bufsize);
+
+/**
+ * @brief decode input `FILE*` to output `FILE*` like `base16384_decode_fp_detailed`, reading bufsize bytes at a time
+ * @param input `FILE*` pointer
+ * @param output `FILE*` pointer
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_decode_fp_ex(base16384_typed_flag_params(FILE*), size_t bufsize);
+
+/**
+ * @brief decode input stream to output stream like `base16384_decode_fd_detailed`, reading bufsize bytes at a time
+ * @param input file descripter
+ * @param output file descripter
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_decode_fd_ex(base16384_typed_flag_params(int), size_t bufsize);
+
+/**
+ * @brief decode custom input reader to custom output writer like `base16384_decode_stream_detailed`, reading bufsize bytes at a time
+ * @param input custom input reader
+ * @param output custom output writer
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`, which never changes the output
+ * @return the error code
+*/
+base16384_err_t base16384_decode_stream_ex(base16384_typed_flag_params(base16384_stream_t*), size_t bufsize);
+
+/**
+ * @brief get the count of cpus this process can use, honoring the cpu
+ *        affinity and the cgroup cpu quota on linux
+ * @return the count, at least 1
+*/
+int base16384_get_nproc();
+
+/**
+ * @brief encode input file to output file, slicing regular files among threads,
+ *        pipelining stdin or stdout like `base16384_encode_stream_parallel`
+ *        and falling back to `base16384_encode_file_detailed` otherwise
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than BASE16384_ENCBUFSZ
+ * @param decbuf must be no less than BASE16384_DECBUFSZ
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @return the error code
+*/
+base16384_err_t base16384_encode_file_parallel(base16384_typed_flag_params(const char*), int threads);
+
+/**
+ * @brief decode input file to output file, slicing regular files among threads,
+ *        pipelining stdin or stdout like `base16384_decode_stream_parallel`
+ *        and falling back to `base16384_decode_file_detailed` otherwise
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than BASE16384_ENCBUFSZ
+ * @param decbuf must be no less than BASE16384_DECBUFSZ
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @return the error code
+*/
+base16384_err_t base16384_decode_file_parallel(base16384_typed_flag_params(const char*), int threads);
+
+/**
+ * @brief encode custom input reader to custom output writer through a pipeline of
+ *        one reader thread, `threads` coding threads and the writer on the caller,
+ *        falling back to `base16384_encode_stream_detailed` if no thread can start
+ * @param input custom input reader, called only by the reader thread
+ * @param output custom output writer, called only by the caller's thread in order
+ * @param encbuf must be no less than BASE16384_ENCBUFSZ
+ * @param decbuf must be no less than BASE16384_DECBUFSZ
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of coding threads, see `base16384_get_nproc`
+ * @param depth the count of chunks in flight, which bounds the memory, 0 for `threads*2`
+ * @return the error code
+*/
+base16384_err_t base16384_encode_stream_parallel(base16384_typed_flag_params(base16384_stream_t*), int threads, int depth);
+
+/**
+ * @brief decode custom input reader to custom output writer through a pipeline of
+ *        one reader thread, `threads` coding threads and the writer on the caller,
+ *        falling back to `base16384_decode_stream_detailed` if no thread can start
+ * @param input custom input reader, called only by the reader thread
+ * @param output custom output writer, called only by the caller's thread in order
+ * @param encbuf must be no less than BASE16384_ENCBUFSZ
+ * @param decbuf must be no less than BASE16384_DECBUFSZ
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of coding threads, see `base16384_get_nproc`
+ * @param depth the count of chunks in flight, which bounds the memory, 0 for `threads*2`
+ * @return the error code
+*/
+base16384_err_t base16384_decode_stream_parallel(base16384_typed_flag_params(base16384_stream_t*), int threads, int depth);
+
+/**
+ * @brief encode input file to output file like `base16384_encode_file_parallel`,
+ *        coding slices and chunks of bufsize bytes
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`
+ * @return the error code
+*/
+base16384_err_t base16384_encode_file_parallel_ex(base16384_typed_flag_params(const char*), int threads, size_t bufsize);
+
+/**
+ * @brief encode custom input reader to custom output writer like
+ *        `base16384_encode_stream_parallel`, in chunks of bufsize bytes
+ * @param input custom input reader, called only by the reader thread
+ * @param output custom output writer, called only by the caller's thread in order
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of coding threads, see `base16384_get_nproc`
+ * @param depth the count of chunks in flight, which bounds the memory, 0 for `threads*2`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`
+ * @return the error code
+*/
+base16384_err_t base16384_encode_stream_parallel_ex(base16384_typed_flag_params(base16384_stream_t*), int threads, int depth, size_t bufsize);
+
+/**
+ * @brief decode input file to output file like `base16384_decode_file_parallel`,
+ *        coding slices and chunks of bufsize bytes
+ * @param input filename or `-` to specify stdin
+ * @param output filename or `-` to specify stdout
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`
+ * @return the error code
+*/
+base16384_err_t base16384_decode_file_parallel_ex(base16384_typed_flag_params(const char*), int threads, size_t bufsize);
+
+/**
+ * @brief verify the BASE16384_FLAG_CRC_TREE trailer of an encoded regular file by threads,
+ *        decoding and hashing its blocks without writing the data anywhere
+ * @param input the encoded filename
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @param leaves the leaves the data should have like `base16384_crc_tree_leaves` to locate the damage, or NULL
+ * @param badblock receives the index of the first block whose leaf differs from leaves, or -1 if none
+ * @return base16384_err_invalid_decoding_checksum if the root digest differs, or else the error code
+*/
+base16384_err_t base16384_verify_file_parallel(const char* input, int threads, const uint32_t* leaves, ssize_t* badblock);
+
+/**
+ * @brief decode the bytes [offset, offset+len) of the data in an encoded file,
+ *        reading only the groups that cover them and the `=` remainder at the end
+ * @param fd the encoded file descriptor, which must be seekable
+ * @param offset where the range starts in the decoded data
+ * @param len the range length, which is cut at the end of the data
+ * @param buf the output buffer of at least len bytes
+ * @param flag BASE16384_FLAG_xxx value, whose trailer flags skip the trailer, checksums not verified
+ * @return the length decoded, 0 if offset is at or after the end, or -1 with errno
+*/
+ssize_t base16384_decode_range(int fd, off_t offset, size_t len, char* buf, int flag);
+
+#ifndef _WIN32
+
+// the data bytes per chunk of base16384_encode_container by default, whole groups
+#ifndef BASE16384_CONTAINER_CHUNK
+	#define BASE16384_CONTAINER_CHUNK ((size_t)7<<17)
+#endif
+
+// the checksum types of the container chunks
+#define BASE16384_CONTAINER_NONE	(0)
+#define BASE16384_CONTAINER_CRC32C	(1)
+
+struct base16384_container_t {
+	uint64_t length;		// the data length
+	uint32_t chunk;			// the data bytes per chunk but the last one
+	int checksum;			// BASE16384_CONTAINER_xxx
+	uint64_t count;			// the count of chunks
+	off_t base;				// where the container starts, after the 0xFEFF header
+	uint64_t* offsets;		// where the count chunks and then the index start, from base
+	uint32_t* checksums;	// the checksums of the chunks
+};
+/**
+ * @brief the header and the index of a container opened by base16384_container_open
+*/
+typedef struct base16384_container_t base16384_container_t;
+
+/**
+ * @brief encode input into a seekable container of a header, the chunks coded one
+ *        by one, an index of their offsets and checksums and a fixed footer
+ * @param input the input file descriptor, which may be a pipe
+ * @param output the output file descriptor, which may be a pipe
+ * @param flag BASE16384_FLAG_NOHEADER and BASE16384_FLAG_CRC32C for the checksum of each chunk
+ * @param chunk the data bytes per chunk, rounded down to whole groups, 0 for BASE16384_CONTAINER_CHUNK
+ * @return the error code
+*/
+base16384_err_t base16384_encode_container(int input, int output, int flag, size_t chunk);
+
+/**
+ * @brief read the header, the footer and the index of a container without scanning the chunks
+ * @param fd the container file descriptor, which must be seekable
+ * @param c receives the container, which must be closed by base16384_container_close
+ * @return 0 on success or -1 with errno, EBADMSG if it is no valid container
+*/
+int base16384_container_open(int fd, base16384_container_t* c);
+
+/**
+ * @brief free the index of a container
+ * @param c the opened container
+*/
+void base16384_container_close(base16384_container_t* c);
+
+/**
+ * @brief decode and verify one chunk of a container on demand, which any thread may do
+ * @param fd the container file descriptor
+ * @param c the opened container
+ * @param i the index of the chunk
+ * @param buf the output of at least c->chunk bytes
+ * @param codebuf the buffer of at least c->chunk/7*8+16 bytes for the coded chunk
+ * @return the chunk length or -1 with errno, EBADMSG if the chunk is damaged
+*/
+ssize_t base16384_container_read_chunk(int fd, const base16384_container_t* c, uint64_t i, char* buf, char* codebuf);
+
+/**
+ * @brief decode a whole container by threads, writing a damaged chunk as zeros and going on
+ * @param input the container file descriptor, which must be seekable
+ * @param output the output file descriptor, which is written in order by one thread if not a regular file
+ * @param threads the count of threads, see `base16384_get_nproc`
+ * @param badchunk receives the index of the first damaged chunk or -1, or NULL
+ * @return base16384_err_invalid_decoding_checksum if any chunk is damaged, or else the error code
+*/
+base16384_err_t base16384_decode_container(int input, int output, int threads, int64_t* badchunk);
+
+#endif
+
+/**
+ * @brief decode custom input reader to custom output writer like
+ *        `base16384_decode_stream_parallel`, in chunks of bufsize bytes
+ * @param input custom input reader, called only by the reader thread
+ * @param output custom output writer, called only by the caller's thread in order
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param threads the count of coding threads, see `base16384_get_nproc`
+ * @param depth the count of chunks in flight, which bounds the memory, 0 for `threads*2`
+ * @param bufsize the bytes read at a time, see `base16384_get_bufsize`
+ * @return the error code
+*/
+base16384_err_t base16384_decode_stream_parallel_ex(base16384_typed_flag_params(base16384_stream_t*), int threads, int depth, size_t bufsize);
+
 #define BASE16384_WRAP_DECL(method, name, type) \
 	base16384_err_t base16384_##method##_##name(base16384_typed_params(type));
 
@@ -319,6 +1103,95 @@ base16384_err_t base16384_decode_stream_detailed(base16384_typed_flag_params(bas
 
 #undef BASE16384_WRAP_DECL
 
+/**
+ * @brief en/decode input to output like `base16384_xxcode_xx_ex`, using the buffers of ctx,
+ *        where the fd ones go without splice and io_uring, which allocate buffers per call
+ * @param input filename, `FILE*` pointer, file descripter or custom input reader
+ * @param output filename, `FILE*` pointer, file descripter or custom output writer
+ * @param ctx an initialized context
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @return the error code
+*/
+#define BASE16384_CTX_DECL(method, name, type) \
+	base16384_err_t base16384_##method##_##name##_ctx(type input, type output, base16384_ctx_t* ctx, int flag);
+
+	BASE16384_CTX_DECL(encode, file, const char*);
+	BASE16384_CTX_DECL(encode, fp, FILE*);
+	BASE16384_CTX_DECL(encode, fd, int);
+	BASE16384_CTX_DECL(encode, stream, base16384_stream_t*);
+
+	BASE16384_CTX_DECL(decode, file, const char*);
+	BASE16384_CTX_DECL(decode, fp, FILE*);
+	BASE16384_CTX_DECL(decode, fd, int);
+	BASE16384_CTX_DECL(decode, stream, base16384_stream_t*);
+
+#undef BASE16384_CTX_DECL
+
+#ifndef _WIN32
+
+/**
+ * @brief calculate the exact output size of `base16384_encode_iov`
+ * @param iov the fragments of the data
+ * @param iovcnt the count of fragments
+ * @return the size
+*/
+int base16384_encode_iov_len(const struct iovec* iov, int iovcnt);
+
+/**
+ * @brief encode the fragments as one piece of data without copying them together,
+ *        the same as `base16384_encode_safe` on their concatenation
+ * @param iov the fragments of the data, no data overread
+ * @param iovcnt the count of fragments
+ * @param buf the output buffer, whose size can be exactly `base16384_encode_iov_len`
+ * @return the total length written
+*/
+int base16384_encode_iov(const struct iovec* iov, int iovcnt, char* buf);
+
+/**
+ * @brief calculate the maximum output size of `base16384_decode_iov`
+ * @param iov the fragments of the data
+ * @param iovcnt the count of fragments
+ * @return the size
+*/
+int base16384_decode_iov_len(const struct iovec* iov, int iovcnt);
+
+/**
+ * @brief decode the fragments as one piece of data without copying them together,
+ *        the same as `base16384_decode_safe` on their concatenation. They can be split
+ *        anywhere and the leading 0xFEFF is skipped.
+ * @param iov the fragments of the data, no data overread
+ * @param iovcnt the count of fragments
+ * @param buf the output buffer, whose size must be no less than `base16384_decode_iov_len`
+ * @return the total length written or -1 with errno EINVAL on a broken remainder
+*/
+int base16384_decode_iov(const struct iovec* iov, int iovcnt, char* buf);
+
+/**
+ * @brief encode the fragments as one file to output like `base16384_encode_fd_ex`
+ * @param iov the fragments of the data
+ * @param iovcnt the count of fragments
+ * @param output output file descripter
+ * @param decbuf must be no less than `base16384_decbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes coded at a time
+ * @return the error code
+*/
+base16384_err_t base16384_encode_iov_fd(const struct iovec* iov, int iovcnt, int output, char* decbuf, int flag, size_t bufsize);
+
+/**
+ * @brief decode the fragments as one file to output like `base16384_decode_fd_ex`
+ * @param iov the fragments of the data
+ * @param iovcnt the count of fragments
+ * @param output output file descripter
+ * @param encbuf must be no less than `base16384_encbuf_len(bufsize)`
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param bufsize the bytes coded at a time
+ * @return the error code
+*/
+base16384_err_t base16384_decode_iov_fd(const struct iovec* iov, int iovcnt, int output, char* encbuf, int flag, size_t bufsize);
+
+#endif
+
 #undef base16384_typed_flag_params
 #undef base16384_typed_params
 
@@ -340,6 +1213,7 @@ static inline base16384_err_t base16384_perror(base16384_err_t err) {
 			base16384_perror_case(invalid_file_name); break;
 			base16384_perror_case(invalid_commandline_parameter); break;
 			base16384_perror_case(invalid_decoding_checksum); break;
+			base16384_perror_case(invalid_container); break;
 			default: perror("base16384"); break;
 		}
 	#undef base16384_perror_case
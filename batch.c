@@ -0,0 +1,211 @@
+/* batch.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+#include "base16384.h"
+
+/*
+ * Short items spend most of their time in calls and in the remainder switch,
+ * so they are gathered into whole groups first, with the underfilled group
+ * padded by zero bits, which is exactly how the remainder is coded. Then the
+ * groups of many items are coded by one kernel call and the results are
+ * scattered back by lengths known from the remainder alone.
+*/
+
+#define BATCH_GROUPS (1024)	// groups gathered for one kernel call, 7 KiB in and 8 KiB out
+
+// the code units of the underfilled group of r bytes
+static const int remain_units[7] = {0, 1, 2, 2, 3, 3, 4};
+
+#define item_start(k) (offsets?(size_t)offsets[k]:(size_t)(k)*stride)
+#define item_len(k) (offsets?(size_t)(offsets[(k)+1]-offsets[k]):stride)
+
+#define set_validity(k, v) { \
+	if(v) validity[(k)>>3] |= (uint8_t)(1<<((k)&7)); \
+	else validity[(k)>>3] &= (uint8_t)~(1<<((k)&7)); \
+}
+
+int base16384_encode_batch_len(const int* offsets, int n) {
+	int i, len = 0;
+	for(i = 0; i < n; i++) len += _base16384_encode_len(offsets[i+1]-offsets[i]);
+	return len;
+}
+
+// code the items of offsets, or of stride bytes each if offsets is NULL
+static int encode_items(const char* data, const int* offsets, size_t stride, int n, char* buf, int* outoffsets) {
+	char in[BATCH_GROUPS*7], out[BATCH_GROUPS*8];
+	size_t o = 0, g;
+	int i = 0, k, first;
+	if(outoffsets) outoffsets[0] = 0;
+	while(i < n) {
+		for(first = i, g = 0; i < n; i++) {
+			size_t len = item_len(i), groups = (len+6)/7;
+			if(g + groups > BATCH_GROUPS) break;
+			memcpy(in+g*7, data+item_start(i), len);
+			memset(in+g*7+len, 0, groups*7-len);
+			g += groups;
+		}
+		if(i == first) { // too long to gather, code it in place
+			o += base16384_encode_safe(data+item_start(i), (int)item_len(i), buf+o);
+			if(outoffsets) outoffsets[i+1] = (int)o;
+			i++;
+			continue;
+		}
+		base16384_encode_safe(in, (int)g*7, out);
+		for(k = first, g = 0; k < i; k++) {
+			size_t len = item_len(k);
+			int r = (int)(len%7), m = (int)(len/7*8) + remain_units[r]*2;
+			memcpy(buf+o, out+g*8, m);
+			o += m;
+			if(r) {
+				buf[o++] = '=';
+				buf[o++] = (char)r;
+			}
+			if(outoffsets) outoffsets[k+1] = (int)o;
+			g += (len+6)/7;
+		}
+	}
+	return (int)o;
+}
+
+int base16384_encode_batch(const char* data, const int* offsets, int n, char* buf, int* outoffsets) {
+	return encode_items(data, offsets, 0, n, buf, outoffsets);
+}
+
+int base16384_encode_batch_fixed(const char* data, int width, int n, char* buf) {
+	// the items are whole groups back to back, so code them as one
+	if(!(width%7)) return base16384_encode_safe(data, width*n, buf);
+	return encode_items(data, NULL, width, n, buf, NULL);
+}
+
+// the length of the code units of an item or -1 if it is malformed, like base16384_decode_strict
+static int parse_item(const char* p, int len, int* r) {
+	*r = 0;
+	if(len%2) return -1;
+	if(len >= 2 && p[len-2] == '=') {
+		*r = p[len-1];
+		len -= 2;
+		if(*r < 1 || *r > 6 || len < remain_units[*r]*2 || len%8 != remain_units[*r]*2%8) return -1;
+	} else if(len%8) return -1;
+	return len;
+}
+
+int base16384_decode_batch_len(const char* data, const int* offsets, int n) {
+	int i, len = 0, r;
+	for(i = 0; i < n; i++) {
+		int body = parse_item(data+offsets[i], offsets[i+1]-offsets[i], &r);
+		if(body > 0) len += (body - remain_units[r]*2)/8*7 + r;
+	}
+	return len;
+}
+
+// decode g gathered groups, marking the invalid ones in bad
+static void decode_groups(const char* in, size_t g, char* out, uint8_t* bad) {
+	size_t done = 0;
+	int errpos;
+	memset(bad, 0, g);
+	while(done < g && base16384_decode_strict(in+done*8, (int)(g-done)*8, out+done*7, &errpos) < 0) {
+		size_t ok = (size_t)errpos/8;
+		// the valid groups after the kernel stopped are only checked
+		if(ok) base16384_decode_safe(in+done*8, (int)ok*8, out+done*7);
+		bad[done+ok] = 1;
+		done += ok+1;
+	}
+}
+
+/*
+ * Decode the items of offsets into buf and outoffsets, or the items of
+ * stride bytes each into width bytes each if offsets is NULL.
+*/
+static int decode_items(const char* data, const int* offsets, size_t stride, int width, int n, char* buf, int* outoffsets, uint8_t* validity) {
+	char in[BATCH_GROUPS*8], out[BATCH_GROUPS*7];
+	uint8_t bad[BATCH_GROUPS];
+	size_t o = 0, g;
+	int i = 0, k, first, r, valid = 0;
+	if(outoffsets) outoffsets[0] = 0;
+	while(i < n) {
+		for(first = i, g = 0; i < n; i++) {
+			const char* p = data+item_start(i);
+			int body = parse_item(p, (int)item_len(i), &r);
+			if(body <= 0) continue;
+			size_t groups = (size_t)(body+7)/8, j;
+			if(g + groups > BATCH_GROUPS) break;
+			memcpy(in+g*8, p, body);
+			for(j = body; j < groups*8; j += 2) { // zero code units
+				in[g*8+j] = 0x4e;
+				in[g*8+j+1] = 0;
+			}
+			g += groups;
+		}
+		int direct = i == first;	// too long to gather, decode it in place
+		if(direct) i++;
+		else decode_groups(in, g, out, bad);
+		for(k = first, g = 0; k < i; k++) {
+			const char* p = data+item_start(k);
+			int len = (int)item_len(k), body = parse_item(p, len, &r), m = -1;
+			char* dst = offsets?(buf+o):(buf+(size_t)k*width);
+			if(body >= 0) {
+				size_t groups = (size_t)(body+7)/8, j;
+				m = (body - remain_units[r]*2)/8*7 + r;
+				if(!offsets && m != width) m = -1;
+				else if(direct) m = base16384_decode_strict(p, len, dst, NULL);
+				else {
+					for(j = 0; j < groups; j++) if(bad[g+j]) m = -1;
+					if(m > 0) memcpy(dst, out+g*7, m);
+				}
+				g += groups;
+			}
+			if(m < 0 && !offsets) memset(dst, 0, width);
+			set_validity(k, m >= 0);
+			if(m >= 0) {
+				valid++;
+				if(offsets) o += m;
+			}
+			if(outoffsets) outoffsets[k+1] = (int)o;
+		}
+	}
+	return valid;
+}
+
+int base16384_decode_batch(const char* data, const int* offsets, int n, char* buf, int* outoffsets, uint8_t* validity) {
+	return decode_items(data, offsets, 0, 0, n, buf, outoffsets, validity);
+}
+
+int base16384_decode_batch_fixed(const char* data, int width, int n, char* buf, uint8_t* validity) {
+	int k, valid = 0;
+	if(width%7 || !width) return decode_items(data, NULL, _base16384_encode_len(width), width, n, buf, NULL, validity);
+	// the items are whole groups back to back, so decode them as one
+	size_t per = width/7, g = per*n, done = 0, item;
+	int errpos;
+	for(k = 0; k < n; k++) set_validity(k, 1);
+	while(done < g && base16384_decode_strict(data+done*8, (int)(g-done)*8, buf+done*7, &errpos) < 0) {
+		size_t ok = (size_t)errpos/8;
+		if(ok) base16384_decode_safe(data+done*8, (int)ok*8, buf+done*7);
+		item = (done+ok)/per;
+		memset(buf+item*width, 0, width);
+		set_validity(item, 0);
+		done = (item+1)*per;
+	}
+	for(k = 0; k < n; k++) valid += (validity[k>>3]>>(k&7))&1;
+	return valid;
+}
@@ -0,0 +1,229 @@
+/* coder.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <string.h>
+#include <errno.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+
+// update the CRC32C or the tree of BASE16384_FLAG_CRC32C or BASE16384_FLAG_CRC_TREE
+#define update_crc(coder, data, len) \
+	if((coder)->flag&BASE16384_FLAG_CRC_TREE) crc_tree_update(&(coder)->crc, &(coder)->root, &(coder)->leaf_len, data, len); \
+	else if((coder)->flag&BASE16384_FLAG_CRC32C) (coder)->crc = base16384_crc32c((coder)->crc, data, len);
+
+// the digest in the trailer
+#define final_crc(coder) (((coder)->flag&BASE16384_FLAG_CRC_TREE)?crc_tree_final((coder)->crc, (coder)->root, (coder)->leaf_len):(coder)->crc)
+
+// the code units of the underfilled group of r bytes
+static const int remain_units[7] = {0, 1, 2, 2, 3, 3, 4};
+
+// encode without the sum, as UTF-8 for BASE16384_FLAG_UTF8
+#define encode_units(coder, data, dlen, buf) \
+	(is_utf8((coder)->flag)?base16384_encode_utf8(data, dlen, buf):base16384_encode_safe(data, dlen, buf))
+
+// encode whole groups and update the sum by blocks that are still in L1
+static inline int encode_groups(base16384_encoder_t* enc, const char* data, int dlen, char* buf) {
+	int n = 0, i, m;
+	if(!do_sum_check(enc->flag)) return encode_units(enc, data, dlen, buf);
+	if(!is_utf8(enc->flag)) return encode_sum(data, dlen, buf, &enc->sum);
+	for(i = 0; i < dlen; i += m) {
+		m = (dlen - i > SUM_BLOCK_GROUPS*7)?SUM_BLOCK_GROUPS*7:dlen-i;
+		n += base16384_encode_utf8(data+i, m, buf+n);
+		enc->sum = calc_sum(enc->sum, m, data+i);
+	}
+	return n;
+}
+
+void base16384_encoder_init(base16384_encoder_t* enc, int flag) {
+	enc->remain_len = 0;
+	enc->sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
+	enc->crc = 0;
+	enc->root = 0;
+	enc->leaf_len = 0;
+	enc->flag = flag;
+	enc->header_pending = !(flag&BASE16384_FLAG_NOHEADER);
+}
+
+int base16384_encoder_update(base16384_encoder_t* enc, const char* data, int dlen, char* buf) {
+	int n = 0;
+	if(enc->header_pending) { // U+FEFF
+		if(is_utf8(enc->flag)) {
+			buf[n++] = (char)0xEF;
+			buf[n++] = (char)0xBB;
+			buf[n++] = (char)0xBF;
+		} else {
+			buf[n++] = (char)0xFE;
+			buf[n++] = (char)0xFF;
+		}
+		enc->header_pending = 0;
+	}
+	if(dlen <= 0) return n;
+	update_crc(enc, data, dlen);
+	int summing = do_sum_check(enc->flag);
+	if(enc->remain_len) {
+		int fill = 7 - enc->remain_len;
+		if(dlen < fill) fill = dlen;
+		if(summing) enc->sum = calc_sum(enc->sum, fill, data);
+		memcpy(enc->remain+enc->remain_len, data, fill);
+		enc->remain_len += fill;
+		data += fill;
+		dlen -= fill;
+		if(enc->remain_len < 7) return n;
+		n += encode_units(enc, enc->remain, 7, buf+n);
+		enc->remain_len = 0;
+	}
+	int full = dlen / 7 * 7;
+	if(full) n += encode_groups(enc, data, full, buf+n);
+	enc->remain_len = dlen - full;
+	if(summing) enc->sum = calc_sum(enc->sum, enc->remain_len, data+full);
+	memcpy(enc->remain, data+full, enc->remain_len);
+	return n;
+}
+
+int base16384_encoder_final(base16384_encoder_t* enc, char* buf) {
+	int n = base16384_encoder_update(enc, NULL, 0, buf);
+	if(enc->remain_len) {
+		// encode_unsafe reads over the remain, where the sum is hidden like file.c does
+		char tmp[16] = {0}, out[16];
+		memcpy(tmp, enc->remain, enc->remain_len);
+		if(do_sum_check(enc->flag)) {
+			*(uint32_t*)(&tmp[enc->remain_len]) = htobe32(enc->sum);
+		}
+		int m = base16384_encode_unsafe(tmp, enc->remain_len, out);
+		if(is_utf8(enc->flag)) m = utf16_to_utf8(out, m, buf+n);
+		else memcpy(buf+n, out, m);
+		enc->remain_len = 0;
+		n += m;
+	}
+	if(has_trailer(enc->flag)) { // a whole coding of its own, after the `=` remainder
+		uint32_t crc = htobe32(final_crc(enc));
+		n += encode_units(enc, (const char*)&crc, sizeof(crc), buf+n);
+	}
+	return n;
+}
+
+void base16384_decoder_init(base16384_decoder_t* dec, int flag) {
+	dec->remain_len = 0;
+	dec->sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
+	dec->crc = 0;
+	dec->root = 0;
+	dec->leaf_len = 0;
+	dec->total = 0;
+	dec->flag = flag;
+	dec->header_pending = 1;
+}
+
+static inline int decode_groups(base16384_decoder_t* dec, const char* data, int dlen, char* buf) {
+	int n = 0, i, m;
+	if(!is_utf8(dec->flag)) n = do_sum_check(dec->flag)?decode_sum(data, dlen, buf, &dec->sum):base16384_decode_safe(data, dlen, buf);
+	else if(!do_sum_check(dec->flag)) n = base16384_decode_utf8(data, dlen, buf);
+	else for(i = 0; i < dlen; i += SUM_BLOCK_GROUPS*12) {
+		m = base16384_decode_utf8(data+i, (dlen - i > SUM_BLOCK_GROUPS*12)?SUM_BLOCK_GROUPS*12:dlen-i, buf+n);
+		dec->sum = calc_sum(dec->sum, m, buf+n);
+		n += m;
+	}
+	update_crc(dec, buf, n);
+	dec->total += n;
+	return n;
+}
+
+int base16384_decoder_update(base16384_decoder_t* dec, const char* data, int dlen, char* buf) {
+	if(dlen <= 0) return 0;
+	int unit = is_utf8(dec->flag)?3:2, group = unit*4;
+	if(dec->header_pending) {
+		while(dlen && dec->remain_len < unit) {
+			dec->remain[dec->remain_len++] = *data++;
+			dlen--;
+		}
+		if(dec->remain_len < unit) return 0;
+		if(is_utf8(dec->flag)?!memcmp(dec->remain, "\xEF\xBB\xBF", 3):(dec->remain[0] == (char)0xFE && dec->remain[1] == (char)0xFF)) dec->remain_len = 0;
+		dec->header_pending = 0;
+	}
+	// the `=` remainder may follow a full group, so hold back the last 1~5 units and the trailer
+	int hold = (5 + (has_trailer(dec->flag)?BASE16384_CRC32C_TRAILER_LEN/2:0))*unit;
+	int avail = dec->remain_len + dlen;
+	int groups = (avail > hold)?(avail-hold+group-1)/group:0;
+	int n = 0;
+	while(groups && dec->remain_len) {
+		if(dec->remain_len < group) {
+			int fill = group - dec->remain_len;
+			memcpy(dec->remain+dec->remain_len, data, fill);
+			data += fill;
+			dlen -= fill;
+			dec->remain_len = group;
+		}
+		n += decode_groups(dec, dec->remain, group, buf+n);
+		dec->remain_len -= group;
+		memmove(dec->remain, dec->remain+group, dec->remain_len);
+		groups--;
+	}
+	if(groups) {
+		n += decode_groups(dec, data, groups*group, buf+n);
+		data += groups*group;
+		dlen -= groups*group;
+	}
+	memcpy(dec->remain+dec->remain_len, data, dlen);
+	dec->remain_len += dlen;
+	return n;
+}
+
+int base16384_decoder_final(base16384_decoder_t* dec, char* buf) {
+	int len = dec->remain_len, n = 0;
+	char trailer[BASE16384_CRC32C_TRAILER_LEN];
+	dec->remain_len = 0;
+	if(is_utf8(dec->flag)) len = utf8_to_utf16(dec->remain, len, dec->remain);
+	if(has_trailer(dec->flag)) {
+		if(len < BASE16384_CRC32C_TRAILER_LEN) {
+			errno = EINVAL;
+			return -1;
+		}
+		len -= BASE16384_CRC32C_TRAILER_LEN;
+		memcpy(trailer, dec->remain+len, BASE16384_CRC32C_TRAILER_LEN);
+	}
+	if(len >= 2 && dec->remain[len-2] == '=') { // the `=` remainder must follow the units of its group
+		int offset = dec->remain[len-1];
+		if(offset < 1 || offset > 6 || len < remain_units[offset]*2+2) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	if(len) {
+		// decode_unsafe writes the padding bits after the data, where the sum is hidden
+		char tmp[32] = {0}, out[32];
+		memcpy(tmp, dec->remain, len);
+		n = base16384_decode_unsafe(tmp, len, out);
+		memcpy(buf, out, n);
+		if(do_sum_check(dec->flag)) dec->sum = calc_sum(dec->sum, n, out);
+		update_crc(dec, out, n);
+		dec->total += n;
+		if(do_sum_check(dec->flag)
+			&& (dec->flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || dec->total >= _BASE16384_ENCBUFSZ)
+			&& len > 2 && tmp[len-2] == '='
+			&& check_sum(dec->sum, *(uint32_t*)(&out[n]), tmp[len-1])) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	if(has_trailer(dec->flag) && check_crc(trailer, final_crc(dec))) {
+		errno = EINVAL;
+		return -1;
+	}
+	return n;
+}
@@ -0,0 +1,365 @@
+/* container.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WIN32
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+
+/*
+ * The container is a run of codings of its own after the optional 0xFEFF:
+ *
+ *   header  21 bytes, 24 coded: "B16C", version, checksum type, 0,
+ *           chunk size be32, data length be64 or all ones if unknown, 0, 0
+ *   chunks  every chunk size bytes coded alone, only the last one may end
+ *           with the `=` remainder, as chunk size is whole groups
+ *   index   a be64 offset of each chunk from after 0xFEFF and its be32 checksum
+ *   footer  35 bytes, 40 coded: "B16I", data length be64, index offset be64,
+ *           chunk count be64, the CRC32C of the index be32, 0, 0, 0
+ *
+ * The footer has a fixed length at the end, so a reader finds the index
+ * there and then decodes any chunk alone.
+*/
+
+#define CONTAINER_HEADER_LEN (21)
+#define CONTAINER_FOOTER_LEN (35)
+#define CONTAINER_ENTRY_LEN (12)
+#define CONTAINER_VERSION (1)
+#define coded_len(n) ((n)/7*8)	// for whole groups
+
+#define put_be32(p, x) { uint32_t _v = htobe32((uint32_t)(x)); memcpy((p), &_v, 4); }
+#define put_be64(p, x) { put_be32((p), (uint64_t)(x)>>32); put_be32((p)+4, (x)); }
+#define get_be64(p) (((uint64_t)get_be32(p)<<32) | get_be32((p)+4))
+
+static inline uint32_t get_be32(const char* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return be32toh(v);
+}
+
+#define goto_container_cleanup(reason) { \
+	errnobak = errno; \
+	retval = reason; \
+	goto base16384_container_cleanup; \
+}
+
+base16384_err_t base16384_encode_container(int input, int output, int flag, size_t chunk) {
+	if(input < 0) {
+		errno = EINVAL;
+		return base16384_err_fopen_input_file;
+	}
+	if(output < 0) {
+		errno = EINVAL;
+		return base16384_err_fopen_output_file;
+	}
+	if(!chunk) chunk = BASE16384_CONTAINER_CHUNK;
+	chunk = (chunk < 7)?7:((chunk > ((size_t)1<<30))?((size_t)1<<30)/7*7:chunk/7*7);
+	base16384_err_t retval = base16384_err_ok;
+	int errnobak = 0, checksum = has_trailer(flag)?BASE16384_CONTAINER_CRC32C:BASE16384_CONTAINER_NONE;
+	struct stat st;
+	uint64_t length = (!fstat(input, &st) && S_ISREG(st.st_mode))?(uint64_t)st.st_size:~(uint64_t)0;
+	char *in = (char*)malloc(chunk), *out = (char*)malloc(coded_len(chunk)+16), *index = NULL;
+	char head[CONTAINER_FOOTER_LEN+2], coded[48];
+	size_t count = 0, cap = 0;
+	uint64_t total = 0, off = 0;
+	if(!in || !out) {
+		errno = ENOMEM;
+		goto_container_cleanup(base16384_err_read_file);
+	}
+	if(!(flag&BASE16384_FLAG_NOHEADER) && write_full(output, "\xfe\xff", 2)) {
+		goto_container_cleanup(base16384_err_write_file);
+	}
+	memset(head, 0, CONTAINER_HEADER_LEN);
+	memcpy(head, "B16C", 4);
+	head[4] = CONTAINER_VERSION;
+	head[5] = (char)checksum;
+	put_be32(head+7, chunk);
+	put_be64(head+11, length);
+	off = base16384_encode_safe(head, CONTAINER_HEADER_LEN, coded);
+	if(write_full(output, coded, off)) {
+		goto_container_cleanup(base16384_err_write_file);
+	}
+	ssize_t n;
+	while((n = read_all(input, in, chunk)) > 0) {
+		if(count == cap) {
+			cap = cap?cap*2:64;
+			char* p = (char*)realloc(index, cap*CONTAINER_ENTRY_LEN);
+			if(!p) {
+				errno = ENOMEM;
+				goto_container_cleanup(base16384_err_read_file);
+			}
+			index = p;
+		}
+		put_be64(index+count*CONTAINER_ENTRY_LEN, off);
+		put_be32(index+count*CONTAINER_ENTRY_LEN+8, checksum?base16384_crc32c(0, in, n):0);
+		int m = base16384_encode_safe(in, (int)n, out);
+		if(write_full(output, out, m)) {
+			goto_container_cleanup(base16384_err_write_file);
+		}
+		count++;
+		off += m;
+		total += n;
+		if((size_t)n < chunk) break;	// the last one may end with the remainder
+	}
+	if(n < 0) {
+		goto_container_cleanup(base16384_err_read_file);
+	}
+	// the index, reusing out or a larger buffer for many chunks
+	size_t indexlen = count*CONTAINER_ENTRY_LEN;
+	char* indexout = ((size_t)_base16384_encode_len(indexlen) <= coded_len(chunk)+16)?out:(char*)malloc(_base16384_encode_len(indexlen)+16);
+	if(!indexout) {
+		errno = ENOMEM;
+		goto_container_cleanup(base16384_err_read_file);
+	}
+	int m = indexlen?base16384_encode_safe(index, (int)indexlen, indexout):0;
+	int failed = write_full(output, indexout, m);
+	if(indexout != out) free(indexout);
+	if(failed) {
+		goto_container_cleanup(base16384_err_write_file);
+	}
+	memset(head, 0, CONTAINER_FOOTER_LEN);
+	memcpy(head, "B16I", 4);
+	put_be64(head+4, total);
+	put_be64(head+12, off);
+	put_be64(head+20, count);
+	put_be32(head+28, base16384_crc32c(0, index, indexlen));
+	m = base16384_encode_safe(head, CONTAINER_FOOTER_LEN, coded);
+	if(write_full(output, coded, m)) {
+		goto_container_cleanup(base16384_err_write_file);
+	}
+base16384_container_cleanup:
+	if(in) free(in);
+	if(out) free(out);
+	if(index) free(index);
+	if(errnobak) errno = errnobak;
+	return retval;
+}
+
+#undef goto_container_cleanup
+
+int base16384_container_open(int fd, base16384_container_t* c) {
+	struct stat st;
+	char head[CONTAINER_FOOTER_LEN+16], coded[48];
+	memset(c, 0, sizeof(*c));
+	if(fd < 0 || fstat(fd, &st)) {
+		if(fd < 0) errno = EINVAL;
+		return -1;
+	}
+	if(!S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode)) {
+		errno = ESPIPE;
+		return -1;
+	}
+	if(st.st_size < 2) goto base16384_container_invalid;
+	if(pread_full(fd, head, 2, 0)) return -1;
+	c->base = (head[0] == (char)0xFE && head[1] == (char)0xFF)?2:0;
+	uint64_t size = (uint64_t)st.st_size - c->base;
+	if(size < coded_len(CONTAINER_HEADER_LEN) + coded_len(CONTAINER_FOOTER_LEN)) goto base16384_container_invalid;
+	if(pread_full(fd, coded, coded_len(CONTAINER_HEADER_LEN), c->base)) return -1;
+	if(base16384_decode_safe(coded, coded_len(CONTAINER_HEADER_LEN), head) != CONTAINER_HEADER_LEN
+		|| memcmp(head, "B16C", 4) || head[4] != CONTAINER_VERSION) goto base16384_container_invalid;
+	c->checksum = head[5];
+	c->chunk = get_be32(head+7);
+	if(pread_full(fd, coded, coded_len(CONTAINER_FOOTER_LEN), c->base + (off_t)(size - coded_len(CONTAINER_FOOTER_LEN)))) return -1;
+	if(base16384_decode_safe(coded, coded_len(CONTAINER_FOOTER_LEN), head) != CONTAINER_FOOTER_LEN
+		|| memcmp(head, "B16I", 4)) goto base16384_container_invalid;
+	c->length = get_be64(head+4);
+	uint64_t indexoff = get_be64(head+12);
+	c->count = get_be64(head+20);
+	uint32_t indexsum = get_be32(head+28);
+	uint64_t indexlen = c->count*CONTAINER_ENTRY_LEN, indexcoded = _base16384_encode_len64(indexlen);
+	if(!c->chunk || c->chunk%7 || c->count > size/2 || indexoff + indexcoded + coded_len(CONTAINER_FOOTER_LEN) != size
+		|| c->length > c->count*(uint64_t)c->chunk || (c->count?(c->length <= (c->count-1)*(uint64_t)c->chunk):c->length)) {
+		goto base16384_container_invalid;
+	}
+	char* index = (char*)malloc(indexcoded + indexlen + 16);
+	c->offsets = (uint64_t*)malloc((c->count+1)*sizeof(uint64_t));
+	c->checksums = (uint32_t*)malloc((c->count+1)*sizeof(uint32_t));
+	if(!index || !c->offsets || !c->checksums) {
+		if(index) free(index);
+		base16384_container_close(c);
+		errno = ENOMEM;
+		return -1;
+	}
+	if(pread_full(fd, index, indexcoded, c->base + (off_t)indexoff)) {
+		int errnobak = errno;
+		free(index);
+		base16384_container_close(c);
+		errno = errnobak;
+		return -1;
+	}
+	char* entries = index + indexcoded;
+	int bad = indexlen && base16384_decode_safe(index, (int)indexcoded, entries) != (int)indexlen;
+	bad = bad || base16384_crc32c(0, entries, indexlen) != indexsum;
+	uint64_t i;
+	for(i = 0; !bad && i < c->count; i++) {
+		c->offsets[i] = get_be64(entries+i*CONTAINER_ENTRY_LEN);
+		c->checksums[i] = get_be32(entries+i*CONTAINER_ENTRY_LEN+8);
+		bad = c->offsets[i] != coded_len(CONTAINER_HEADER_LEN) + i*coded_len(c->chunk);
+	}
+	c->offsets[c->count] = indexoff;
+	free(index);
+	if(!bad) return 0;
+	base16384_container_close(c);
+base16384_container_invalid:
+	errno = EBADMSG;
+	return -1;
+}
+
+void base16384_container_close(base16384_container_t* c) {
+	if(c->offsets) free(c->offsets);
+	if(c->checksums) free(c->checksums);
+	c->offsets = NULL;
+	c->checksums = NULL;
+}
+
+ssize_t base16384_container_read_chunk(int fd, const base16384_container_t* c, uint64_t i, char* buf, char* codebuf) {
+	if(i >= c->count) {
+		errno = EINVAL;
+		return -1;
+	}
+	uint64_t len = c->offsets[i+1] - c->offsets[i];
+	size_t want = (i+1 < c->count)?c->chunk:(size_t)(c->length - i*c->chunk);
+	if(len > coded_len(c->chunk)+2) {
+		errno = EBADMSG;
+		return -1;
+	}
+	if(pread_full(fd, codebuf, len, c->base + (off_t)c->offsets[i])) return -1;
+	int n = base16384_decode_strict(codebuf, (int)len, buf, NULL);
+	if(n < 0 || (size_t)n != want || (c->checksum == BASE16384_CONTAINER_CRC32C && base16384_crc32c(0, buf, n) != c->checksums[i])) {
+		errno = EBADMSG;
+		return -1;
+	}
+	return n;
+}
+
+/*
+ * The chunks are decoded by threads in turn, each written at its own
+ * offset, and a damaged chunk is written as zeros so that the others stay
+ * where they were.
+*/
+
+struct base16384_container_worker_t {
+	pthread_t tid;
+	int started;
+	int input, output;
+	int seekable;		// pwrite each chunk, or else write them in order on one thread
+	uint64_t id, nworkers;
+	const base16384_container_t* c;
+	int64_t bad;		// the first damaged chunk or -1
+	base16384_err_t err;
+	int errnum;
+};
+typedef struct base16384_container_worker_t base16384_container_worker_t;
+
+static void* base16384_container_worker(void* arg) {
+	base16384_container_worker_t* w = (base16384_container_worker_t*)arg;
+	const base16384_container_t* c = w->c;
+	char* buf = (char*)malloc(c->chunk + coded_len(c->chunk) + 16);
+	uint64_t i;
+	if(!buf) {
+		w->err = base16384_err_read_file;
+		w->errnum = ENOMEM;
+		return NULL;
+	}
+	for(i = w->id; i < c->count; i += w->nworkers) {
+		ssize_t n = base16384_container_read_chunk(w->input, c, i, buf, buf+c->chunk);
+		if(n < 0) {
+			if(errno != EBADMSG) {
+				w->err = base16384_err_read_file;
+				w->errnum = errno;
+				break;
+			}
+			if(w->bad < 0) w->bad = (int64_t)i;
+			n = (i+1 < c->count)?c->chunk:(size_t)(c->length - i*c->chunk);
+			memset(buf, 0, n);
+		}
+		if(w->seekable?pwrite_full(w->output, buf, n, (off_t)(i*c->chunk)):write_full(w->output, buf, n)) {
+			w->err = base16384_err_write_file;
+			w->errnum = errno;
+			break;
+		}
+	}
+	free(buf);
+	return NULL;
+}
+
+base16384_err_t base16384_decode_container(int input, int output, int threads, int64_t* badchunk) {
+	base16384_container_t c;
+	struct stat st;
+	if(badchunk) *badchunk = -1;
+	if(output < 0) {
+		errno = EINVAL;
+		return base16384_err_fopen_output_file;
+	}
+	if(base16384_container_open(input, &c)) {
+		return (errno == EBADMSG)?base16384_err_invalid_container:base16384_err_read_file;
+	}
+	base16384_container_worker_t proto = {
+		.input = input, .output = output, .nworkers = 1, .c = &c, .bad = -1,
+	};
+	// a regular file is truncated to the data length first, so pwrite may go in any order
+	proto.seekable = !fstat(output, &st) && S_ISREG(st.st_mode) && !ftruncate(output, (off_t)c.length);
+	if(!proto.seekable || threads < 1) threads = 1;
+	if((uint64_t)threads > c.count) threads = c.count?(int)c.count:1;
+	base16384_container_worker_t* workers = (threads > 1)?(base16384_container_worker_t*)calloc(threads, sizeof(base16384_container_worker_t)):NULL;
+	if(!workers) {
+		workers = &proto;
+		threads = 1;
+	}
+	int i;
+	for(i = 0; i < threads; i++) {
+		base16384_container_worker_t* w = &workers[i];
+		if(w != &proto) *w = proto;
+		w->id = i; w->nworkers = threads;
+		if(threads > 1 && !pthread_create(&w->tid, NULL, base16384_container_worker, w)) w->started = 1;
+	}
+	base16384_err_t err = base16384_err_ok;
+	int errnum = 0;
+	int64_t bad = -1;
+	for(i = 0; i < threads; i++) {
+		base16384_container_worker_t* w = &workers[i];
+		if(w->started) pthread_join(w->tid, NULL);
+		else base16384_container_worker(w);	// no more thread, run it on the caller
+		if(!err && w->err) {
+			err = w->err;
+			errnum = w->errnum;
+		}
+		if(w->bad >= 0 && (bad < 0 || w->bad < bad)) bad = w->bad;
+	}
+	if(workers != &proto) free(workers);
+	base16384_container_close(&c);
+	if(badchunk) *badchunk = bad;
+	if(!err && bad >= 0) {
+		err = base16384_err_invalid_decoding_checksum;
+		errnum = EBADMSG;
+	}
+	if(err) errno = errnum;
+	return err;
+}
+
+#endif
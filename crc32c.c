@@ -0,0 +1,94 @@
+/* crc32c.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stdint.h>
+#include <string.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+#include "simd.h"
+
+#define CRC32C_POLY (0x82f63b78)	// Castagnoli, reflected
+
+// crc_table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t crc_table[8][256];
+static int crc_table_ready;
+
+#ifdef _MSC_VER
+	// volatile accesses are acquire and release on msvc
+	#define load_ready() (*(volatile int*)&crc_table_ready)
+	#define store_ready() (*(volatile int*)&crc_table_ready = 1)
+#else
+	#define load_ready() __atomic_load_n(&crc_table_ready, __ATOMIC_ACQUIRE)
+	#define store_ready() __atomic_store_n(&crc_table_ready, 1, __ATOMIC_RELEASE)
+#endif
+
+// racing initializers store the same values
+static void init_crc_table() {
+	uint32_t i, k, c;
+	for(i = 0; i < 256; i++) {
+		for(c = i, k = 0; k < 8; k++) c = (c>>1) ^ (CRC32C_POLY & (0u-(c&1)));
+		crc_table[0][i] = c;
+	}
+	for(i = 0; i < 256; i++) {
+		for(k = 1; k < 8; k++) crc_table[k][i] = (crc_table[k-1][i]>>8) ^ crc_table[0][crc_table[k-1][i]&0xff];
+	}
+	store_ready();
+}
+
+// slice-by-8, which takes 8 bytes per step with independent lookups
+static uint32_t crc32c_sliced(uint32_t crc, const uint8_t* p, size_t len) {
+	if(!load_ready()) init_crc_table();
+	crc = ~crc;
+	#ifndef WORDS_BIGENDIAN
+		for(; len >= 8; len -= 8, p += 8) {
+			uint32_t lo, hi;
+			memcpy(&lo, p, 4);
+			memcpy(&hi, p+4, 4);
+			lo ^= crc;
+			crc = crc_table[7][lo&0xff] ^ crc_table[6][(lo>>8)&0xff]
+				^ crc_table[5][(lo>>16)&0xff] ^ crc_table[4][lo>>24]
+				^ crc_table[3][hi&0xff] ^ crc_table[2][(hi>>8)&0xff]
+				^ crc_table[1][(hi>>16)&0xff] ^ crc_table[0][hi>>24];
+		}
+	#endif
+	while(len--) crc = crc_table[0][(crc^*p++)&0xff] ^ (crc>>8);
+	return ~crc;
+}
+
+uint32_t base16384_crc32c(uint32_t crc, const char* data, size_t len) {
+	size_t n = _base16384_crc32c_simd(&crc, data, len);
+	return (n < len)?crc32c_sliced(crc, (const uint8_t*)data+n, len-n):crc;
+}
+
+size_t base16384_crc_tree_leaves(const char* data, size_t len, uint32_t* leaves) {
+	size_t n = 0;
+	for(; len > BASE16384_CRC_TREE_BLOCK; len -= BASE16384_CRC_TREE_BLOCK, data += BASE16384_CRC_TREE_BLOCK) {
+		leaves[n++] = base16384_crc32c(0, data, BASE16384_CRC_TREE_BLOCK);
+	}
+	if(len) leaves[n++] = base16384_crc32c(0, data, len);
+	return n;
+}
+
+uint32_t base16384_crc_tree_root(const uint32_t* leaves, size_t n) {
+	uint32_t root = 0;
+	size_t i;
+	for(i = 0; i < n; i++) root = crc_tree_fold(root, leaves[i]);
+	return root;
+}
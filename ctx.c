@@ -0,0 +1,101 @@
+/* ctx.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+	#include <malloc.h>
+#else
+	#include <sys/mman.h>
+#endif
+#endif
+#include "base16384.h"
+
+#define CTX_ALIGN (64)	// a cache line
+#define CTX_HUGEPAGE_SIZE ((size_t)2<<20)
+
+#define align_up(x, a) (((x)+(a)-1)/(a)*(a))
+
+// try huge pages first and then transparent ones
+static void* map_buffers(size_t len) {
+	#if !defined _WIN32 && !defined __cosmopolitan && defined MAP_ANONYMOUS
+		void* mem = MAP_FAILED;
+		#ifdef MAP_HUGETLB
+			mem = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		#endif
+		if(mem == MAP_FAILED) {
+			mem = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if(mem == MAP_FAILED) return NULL;
+			#ifdef MADV_HUGEPAGE
+				madvise(mem, len, MADV_HUGEPAGE);
+			#endif
+		}
+		return mem;
+	#else
+		return NULL;
+	#endif
+}
+
+static void* alloc_buffers(size_t len) {
+	#ifdef _WIN32
+		return _aligned_malloc(len, CTX_ALIGN);
+	#else
+		void* mem;
+		return posix_memalign(&mem, CTX_ALIGN, len)?NULL:mem;
+	#endif
+}
+
+int base16384_ctx_init(base16384_ctx_t* ctx, size_t bufsize, int flag, const base16384_allocator_t* allocator) {
+	memset(ctx, 0, sizeof(*ctx));
+	if(!bufsize) bufsize = BASE16384_BUFSZ;
+	size_t enclen = align_up(base16384_encbuf_len(bufsize), CTX_ALIGN);
+	size_t len = enclen + align_up(base16384_decbuf_len(bufsize), CTX_ALIGN);
+	if(flag&BASE16384_CTX_HUGEPAGE) len = align_up(len, CTX_HUGEPAGE_SIZE);
+	if(allocator) {
+		ctx->allocator = *allocator;
+		ctx->mem = allocator->alloc(allocator->opaque, len, (flag&BASE16384_CTX_HUGEPAGE)?CTX_HUGEPAGE_SIZE:CTX_ALIGN);
+	} else if(flag&BASE16384_CTX_HUGEPAGE && (ctx->mem = map_buffers(len))) ctx->mapped = 1;
+	else ctx->mem = alloc_buffers(len);
+	if(!ctx->mem) {
+		errno = ENOMEM;
+		return -1;
+	}
+	ctx->memlen = len;
+	ctx->bufsize = bufsize;
+	ctx->encbuf = (char*)ctx->mem;
+	ctx->decbuf = ctx->encbuf + enclen;
+	return 0;
+}
+
+void base16384_ctx_free(base16384_ctx_t* ctx) {
+	if(!ctx->mem) return;
+	if(ctx->allocator.alloc) ctx->allocator.free(ctx->allocator.opaque, ctx->mem, ctx->memlen);
+	#if !defined _WIN32 && !defined __cosmopolitan
+	else if(ctx->mapped) munmap(ctx->mem, ctx->memlen);
+	#endif
+	#ifdef _WIN32
+	else _aligned_free(ctx->mem);
+	#else
+	else free(ctx->mem);
+	#endif
+	memset(ctx, 0, sizeof(*ctx));
+}
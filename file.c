@@ -22,6 +22,10 @@
 #endif
 #endif
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE	// sync_file_range
+#endif
+
 #ifndef __cosmopolitan
 #include <stdio.h>
 #include <stdint.h>
@@ -41,6 +45,8 @@
 #endif
 #include "base16384.h"
 #include "binary.h"
+#include "uring.h"
+#include "splice.h"
 
 #ifdef __cosmopolitan
 #define get_file_size(filepath) ((off_t)GetFileSize(filepath))
@@ -53,6 +59,8 @@ static inline off_t get_file_size(const char* filepath) {
 
 #define is_standard_io(filename) (*(uint16_t*)(filename) == *(uint16_t*)"-")
 
+#define skip_offset(input_file) ((input_file[0]==(char)0xFE)?2:0)
+
 #define goto_base16384_file_detailed_cleanup(method, reason, dobeforereturn) { \
 	errnobak = errno; \
 	retval = reason; \
@@ -60,9 +68,264 @@ static inline off_t get_file_size(const char* filepath) {
 	goto base16384_##method##_file_detailed_cleanup; \
 }
 
-#define do_sum_check(flag) ((flag)&(BASE16384_FLAG_DO_SUM_CHECK_FORCELY|BASE16384_FLAG_SUM_CHECK_ON_REMAIN))
+#if !defined _WIN32 && !defined __cosmopolitan
+
+#ifndef BASE16384_MMAP_WINDOW_GROUPS
+	// groups coded per mapped window of big files, 7 MiB of data
+	#define BASE16384_MMAP_WINDOW_GROUPS ((size_t)1<<20)
+#endif
+
+// the output is new or regular, which can be sized and mapped
+static inline int is_mappable_output(const char* output) {
+	struct stat statbuf;
+	int errnobak = errno, ret = stat(output, &statbuf)?(errno == ENOENT):S_ISREG(statbuf.st_mode);
+	errno = errnobak;
+	return ret;
+}
+
+// create output with exact size, fdo is -1 if it cannot be opened
+static int create_output_file(const char* output, off_t outputsize, int* fdo) {
+	*fdo = open(output, O_RDWR|O_CREAT|O_TRUNC, 0666);
+	if(*fdo < 0) return -1;
+	#ifdef __linux__
+		// reserve the blocks so that a full disk fails here instead of raising SIGBUS later
+		int err = posix_fallocate(*fdo, 0, outputsize);
+		if(err == ENOSPC || err == EFBIG) {
+			errno = err;
+			return -1;
+		}
+		if(err) return ftruncate(*fdo, outputsize);
+		return 0;
+	#else
+		return ftruncate(*fdo, outputsize);
+	#endif
+}
+
+// map [off, off+len) of fd from the page containing off, and return the pointer to off
+static char* map_window(int fd, off_t off, size_t len, int writable, void** base, size_t* maplen) {
+	static long pagesize = 0;
+	if(!pagesize) pagesize = sysconf(_SC_PAGESIZE);
+	off_t start = off - off%pagesize;
+	*maplen = len + (size_t)(off - start);
+	*base = mmap(NULL, *maplen, writable?(PROT_READ|PROT_WRITE):PROT_READ, writable?MAP_SHARED:MAP_PRIVATE, fd, start);
+	if(*base == MAP_FAILED) return NULL;
+	#ifdef MADV_SEQUENTIAL
+		madvise(*base, *maplen, MADV_SEQUENTIAL);
+	#endif
+	#ifdef MADV_HUGEPAGE
+		madvise(*base, *maplen, MADV_HUGEPAGE);	// only a hint, file mappings may ignore it
+	#endif
+	return (char*)*base + (off - start);
+}
+
+#ifdef POSIX_FADV_DONTNEED
+	#define fadvise(fd, off, len, advice) posix_fadvise(fd, off, len, POSIX_FADV_##advice)
+#else
+	#define fadvise(fd, off, len, advice)
+#endif
 
-base16384_err_t base16384_encode_file_detailed(const char* input, const char* output, char* encbuf, char* decbuf, int flag) {
+/*
+ * Code ngroups groups from input to output window by window, so that only
+ * one window of each file is mapped at a time. The next input window is
+ * read ahead, and the consumed input and the written back output are
+ * dropped from the page cache, so transcoding huge files keeps a bounded
+ * footprint.
+*/
+static base16384_err_t code_windows(int fd, int fdo, int is_encode, size_t ngroups, off_t inoff, off_t outoff, uint32_t* sum, int flag) {
+	size_t inunit = is_encode?7:8, outunit = is_encode?8:7, i, n;
+	off_t lastoff = 0;
+	size_t lastlen = 0;
+	for(i = 0; i < ngroups; i += n) {
+		n = ngroups - i;
+		if(n > BASE16384_MMAP_WINDOW_GROUPS) n = BASE16384_MMAP_WINDOW_GROUPS;
+		off_t ioff = inoff + (off_t)(i*inunit), ooff = outoff + (off_t)(i*outunit);
+		size_t ilen = n*inunit, olen = n*outunit;
+		if(i + n < ngroups) fadvise(fd, ioff + ilen, BASE16384_MMAP_WINDOW_GROUPS*inunit, WILLNEED);
+		void *ibase, *obase;
+		size_t ibaselen, obaselen;
+		char* in = map_window(fd, ioff, ilen, 0, &ibase, &ibaselen);
+		if(!in) return base16384_err_map_input_file;
+		char* out = map_window(fdo, ooff, olen, 1, &obase, &obaselen);
+		if(!out) {
+			munmap(ibase, ibaselen);
+			return base16384_err_write_file;
+		}
+		if(!do_sum_check(flag)) {
+			if(is_encode) base16384_encode_safe(in, (int)ilen, out);
+			else base16384_decode_safe(in, (int)ilen, out);
+		} else if(is_encode) encode_sum(in, (int)ilen, out, sum);
+		else decode_sum(in, (int)ilen, out, sum);
+		munmap(ibase, ibaselen);
+		munmap(obase, obaselen);
+		fadvise(fd, ioff, ilen, DONTNEED);
+		#ifdef __linux__
+			// start writing back this window and drop the last one once it is on disk
+			sync_file_range(fdo, ooff, olen, SYNC_FILE_RANGE_WRITE);
+			if(lastlen) {
+				sync_file_range(fdo, lastoff, lastlen, SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER);
+				fadvise(fdo, lastoff, lastlen, DONTNEED);
+			}
+			lastoff = ooff;
+			lastlen = olen;
+		#endif
+	}
+	return base16384_err_ok;
+}
+
+#undef fadvise
+
+#define close_files() { \
+	if(fdo >= 0) close(fdo); \
+	close(fd); \
+}
+
+// big file, map both input and output window by window and code between them
+static base16384_err_t encode_file_mmap(const char* input, const char* output, off_t inputsize, int flag) {
+	base16384_err_t retval = base16384_err_ok;
+	int errnobak = 0, fdo = -1;
+	int fd = open(input, O_RDONLY);
+	if(fd < 0) {
+		return base16384_err_open_input_file;
+	}
+	size_t ngroups = (size_t)inputsize / 7;
+	int n, remain = (int)(inputsize - (off_t)ngroups*7);
+	off_t h = (flag&BASE16384_FLAG_NOHEADER)?0:2;
+	off_t outputsize = h + (off_t)ngroups*8 + _base16384_encode_len(remain);
+	if(create_output_file(output, outputsize, &fdo)) {
+		goto_base16384_file_detailed_cleanup(encode_mmap, fdo<0?base16384_err_fopen_output_file:base16384_err_write_file, {});
+	}
+	if(h && pwrite(fdo, "\xfe\xff", 2, 0) != 2) {
+		goto_base16384_file_detailed_cleanup(encode_mmap, base16384_err_write_file, {});
+	}
+	base16384_encoder_t enc;
+	base16384_encoder_init(&enc, flag|BASE16384_FLAG_NOHEADER);
+	if((retval = code_windows(fd, fdo, 1, ngroups, 0, h, &enc.sum, flag))) {
+		goto_base16384_file_detailed_cleanup(encode_mmap, retval, {});
+	}
+	// the remainder and its checksum follow all the groups
+	char tail[8], out[16];
+	if(pread(fd, tail, remain, (off_t)ngroups*7) != remain) {
+		goto_base16384_file_detailed_cleanup(encode_mmap, base16384_err_read_file, {});
+	}
+	n = base16384_encoder_update(&enc, tail, remain, out);
+	n += base16384_encoder_final(&enc, out+n);
+	if(pwrite(fdo, out, n, h + (off_t)ngroups*8) != n) {
+		goto_base16384_file_detailed_cleanup(encode_mmap, base16384_err_write_file, {});
+	}
+base16384_encode_mmap_file_detailed_cleanup:
+	close_files();
+	if(errnobak) errno = errnobak;
+	return retval;
+}
+
+// big file, map both input and output window by window and code between them
+static base16384_err_t decode_file_mmap(const char* input, const char* output, off_t inputsize, int flag) {
+	base16384_err_t retval = base16384_err_ok;
+	int errnobak = 0, fdo = -1;
+	int fd = open(input, O_RDONLY);
+	if(fd < 0) {
+		return base16384_err_open_input_file;
+	}
+	char head[2], tail[16], out[32];
+	if(pread(fd, head, 2, 0) != 2) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, base16384_err_read_file, {});
+	}
+	off_t h = skip_offset(head);
+	size_t len = (size_t)(inputsize - h);
+	// like base16384_decoder_t, the last 2~10 bytes may contain the remainder
+	size_t ngroups = (len > 10)?(len-3)/8:0;
+	int remain = (int)(len - ngroups*8);
+	if(pread(fd, tail, remain, h + (off_t)ngroups*8) != remain) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, base16384_err_read_file, {});
+	}
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	dec.header_pending = 0;
+	// decode the tail without checksum first to get the exact output size
+	base16384_decoder_t probe = dec;
+	probe.flag = 0;
+	base16384_decoder_update(&probe, tail, remain, out);
+	int m = base16384_decoder_final(&probe, out);
+	if(m < 0) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, base16384_err_invalid_decoding_checksum, {});
+	}
+	if(create_output_file(output, (off_t)ngroups*7 + m, &fdo)) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, fdo<0?base16384_err_fopen_output_file:base16384_err_write_file, {});
+	}
+	if((retval = code_windows(fd, fdo, 0, ngroups, h, 0, &dec.sum, flag))) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, retval, {});
+	}
+	if(m && pwrite(fdo, out, m, (off_t)ngroups*7) != m) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, base16384_err_write_file, {});
+	}
+	dec.total = ngroups*7;
+	base16384_decoder_update(&dec, tail, remain, out);
+	if(base16384_decoder_final(&dec, out) < 0) {
+		goto_base16384_file_detailed_cleanup(decode_mmap, base16384_err_invalid_decoding_checksum, {});
+	}
+base16384_decode_mmap_file_detailed_cleanup:
+	close_files();
+	if(errnobak) errno = errnobak;
+	return retval;
+}
+
+#undef close_files
+
+#endif
+
+#if !defined _WIN32 && !defined __cosmopolitan
+
+// the L2 cache size of the first cpu, 0 if unknown
+static size_t l2_cache_size() {
+	long n = 0;
+	#ifdef _SC_LEVEL2_CACHE_SIZE
+		n = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	#endif
+	#ifdef __linux__
+		if(n <= 0) { // musl and some archs have no sysconf for it
+			FILE* fp = fopen("/sys/devices/system/cpu/cpu0/cache/index2/size", "r");
+			char unit = 0;
+			if(fp) {
+				if(fscanf(fp, "%ld%c", &n, &unit) < 1) n = 0;
+				else if(unit == 'K') n <<= 10;
+				else if(unit == 'M') n <<= 20;
+				fclose(fp);
+			}
+		}
+	#endif
+	return (n > 0)?(size_t)n:0;
+}
+
+#endif
+
+size_t base16384_get_bufsize(int input, int output) {
+	size_t bufsize = BASE16384_BUFSZ;
+	#if !defined _WIN32 && !defined __cosmopolitan
+		// encbuf and decbuf take about 15/7 of bufsize
+		size_t l2 = l2_cache_size(), blksize = 0;
+		if(l2) bufsize = l2/15*7;
+		int fds[2] = {input, output}, i;
+		for(i = 0; i < 2; i++) {
+			struct stat st;
+			if(fds[i] < 0 || fstat(fds[i], &st)) continue;
+			if(S_ISFIFO(st.st_mode)) {
+				#ifdef F_GETPIPE_SZ
+					// a read never returns more than the pipe holds, and a coded chunk should fit in
+					int pipesz = fcntl(fds[i], F_GETPIPE_SZ);
+					if(pipesz > 0 && (size_t)pipesz*(i?7:8)/8 < bufsize) bufsize = (size_t)pipesz*(i?7:8)/8;
+				#endif
+			} else if((S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)) && (size_t)st.st_blksize > blksize) {
+				blksize = (size_t)st.st_blksize;
+			}
+		}
+		if(blksize) bufsize = (bufsize+blksize-1)/blksize*blksize;
+	#endif
+	if(bufsize < BUFSIZ) bufsize = BUFSIZ;
+	if(bufsize > BASE16384_BUFSZ_MAX) bufsize = BASE16384_BUFSZ_MAX;
+	return bufsize;
+}
+
+base16384_err_t base16384_encode_file_ex(const char* input, const char* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input || !output || strlen(input) <= 0 || strlen(output) <= 0) {
 		errno = EINVAL;
 		return base16384_err_invalid_file_name;
@@ -79,51 +342,65 @@ base16384_err_t base16384_encode_file_detailed(const char* input, const char* ou
 		if(!inputsize) errno = EINVAL;
 		return base16384_err_get_file_size;
 	}
+	#if !defined _WIN32 && !defined __cosmopolitan
+	if(!is_stdin && inputsize >= _BASE16384_ENCBUFSZ && !needs_coder(flag) && !is_standard_io(output) && is_mappable_output(output)) { // big file, use mmap & mmap
+		return encode_file_mmap(input, output, inputsize, flag);
+	}
+	#endif
+	#ifdef BASE16384_SPLICE
+	if(is_standard_io(output) && (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || needs_coder(flag) || inputsize >= _BASE16384_ENCBUFSZ)
+		&& _base16384_is_pipe(STDOUT_FILENO)) { // stdin or big file into a pipe, vmsplice by the fd way
+		int fd = is_stdin?STDIN_FILENO:open(input, O_RDONLY);
+		if(fd < 0) {
+			return base16384_err_open_input_file;
+		}
+		fflush(stdout);
+		retval = base16384_encode_fd_ex(fd, STDOUT_FILENO, encbuf, decbuf, flag, bufsize);
+		errnobak = errno;
+		if(!is_stdin) close(fd);
+		errno = errnobak;
+		return retval;
+	}
+	#endif
 	fpo = is_standard_io(output)?stdout:fopen(output, "wb");
 	if(!fpo) {
 		return base16384_err_fopen_output_file;
 	}
-	if(flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || inputsize >= _BASE16384_ENCBUFSZ) { // stdin or big file, use encbuf & fread
-		inputsize = _BASE16384_ENCBUFSZ;
+	#if !defined _WIN32 && !defined __cosmopolitan
+	if(!needs_coder(flag) && inputsize < _BASE16384_ENCBUFSZ) flag &= ~BASE16384_FLAG_SUM_CHECK_ON_REMAIN;	// small files go without the sum, even if read in pieces
+	#endif
+	if(flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || needs_coder(flag) || inputsize >= _BASE16384_ENCBUFSZ || inputsize > encode_chunk_size(bufsize, flag)) { // stdin, big file, more than bufsize, trailer or UTF-8, use encbuf & fread
+		inputsize = encode_chunk_size(bufsize, flag);
 		#if defined _WIN32 || defined __cosmopolitan
 	}
+	if(inputsize > encode_chunk_size(bufsize, flag)) inputsize = encode_chunk_size(bufsize, flag);	// small file larger than bufsize
 		#endif
 		if(!fp) fp = fopen(input, "rb");
 		if(!fp) {
 			goto_base16384_file_detailed_cleanup(encode, base16384_err_fopen_input_file, {});
 		}
 
-		if(!(flag&BASE16384_FLAG_NOHEADER)) {
-			fputc(0xFE, fpo);
-			fputc(0xFF, fpo);
-		}
 		#ifdef _MSC_VER
 			int cnt;
 		#else
 			size_t cnt;
 		#endif
-		uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
+		int n;
+		base16384_encoder_t enc;
+		base16384_encoder_init(&enc, flag);
 		while((cnt = fread(encbuf, sizeof(char), inputsize, fp)) > 0) {
-			int n;
-			while(cnt%7) {
-				n = fread(encbuf+cnt, sizeof(char), 1, fp);
-				if(n > 0) cnt++;
-				else break;
-			}
-			if(do_sum_check(flag)) {
-				sum = calc_sum(sum, cnt, encbuf);
-				if(cnt%7) { // last encode
-					*(uint32_t*)(&encbuf[cnt]) = htobe32(sum);
-					#ifdef DEBUG
-						fprintf(stderr, "writesum: %08x\n", sum);
-					#endif
-				}
-			}
-			n = base16384_encode_unsafe(encbuf, cnt, decbuf);
+			n = base16384_encoder_update(&enc, encbuf, cnt, decbuf);
 			if(n && fwrite(decbuf, n, 1, fpo) <= 0) {
 				goto_base16384_file_detailed_cleanup(encode, base16384_err_write_file, {});
 			}
 		}
+		if(ferror(fp)) {
+			goto_base16384_file_detailed_cleanup(encode, base16384_err_read_file, {});
+		}
+		n = base16384_encoder_final(&enc, decbuf);
+		if(n && fwrite(decbuf, n, 1, fpo) <= 0) {
+			goto_base16384_file_detailed_cleanup(encode, base16384_err_write_file, {});
+		}
 	#if !defined _WIN32 && !defined __cosmopolitan
 	} else { // small file, use mmap & fwrite
 		int fd = open(input, O_RDONLY);
@@ -156,129 +433,118 @@ base16384_encode_file_detailed_cleanup:
 	return retval;
 }
 
-base16384_err_t base16384_encode_fp_detailed(FILE* input, FILE* output, char* encbuf, char* decbuf, int flag) {
+base16384_err_t base16384_encode_fp_ex(FILE* input, FILE* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input) {
 		return base16384_err_fopen_input_file;
 	}
 	if(!output) {
 		return base16384_err_fopen_output_file;
 	}
-	if(!(flag&BASE16384_FLAG_NOHEADER)) {
-		fputc(0xFE, output);
-		fputc(0xFF, output);
-	}
-	off_t inputsize = _BASE16384_ENCBUFSZ;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
+	off_t inputsize = encode_chunk_size(bufsize, flag);
 	#ifdef _MSC_VER
 		int cnt;
 	#else
 		size_t cnt;
 	#endif
+	int n;
+	base16384_encoder_t enc;
+	base16384_encoder_init(&enc, flag);
 	while((cnt = fread(encbuf, sizeof(char), inputsize, input)) > 0) {
-		int n;
-		while(cnt%7) {
-			n = fread(encbuf+cnt, sizeof(char), 1, input);
-			if(n > 0) cnt++;
-			else break;
-		}
-		if(do_sum_check(flag)) {
-			sum = calc_sum(sum, cnt, encbuf);
-			if(cnt%7) { // last encode
-				*(uint32_t*)(&encbuf[cnt]) = htobe32(sum);
-			}
-		}
-		n = base16384_encode_unsafe(encbuf, cnt, decbuf);
+		n = base16384_encoder_update(&enc, encbuf, cnt, decbuf);
 		if(n && fwrite(decbuf, n, 1, output) <= 0) {
 			return base16384_err_write_file;
 		}
 	}
+	if(ferror(input)) {
+		return base16384_err_read_file;
+	}
+	n = base16384_encoder_final(&enc, decbuf);
+	if(n && fwrite(decbuf, n, 1, output) <= 0) {
+		return base16384_err_write_file;
+	}
 	return base16384_err_ok;
 }
 
-base16384_err_t base16384_encode_fd_detailed(int input, int output, char* encbuf, char* decbuf, int flag) {
+// splice or io_uring may take buffers of their own if own_bufs, as in base16384_encode_fd_ex
+static base16384_err_t encode_fd(int input, int output, char* encbuf, char* decbuf, int flag, size_t bufsize, int own_bufs) {
 	if(input < 0) {
 		return base16384_err_fopen_input_file;
 	}
 	if(output < 0) {
 		return base16384_err_fopen_output_file;
 	}
-	off_t inputsize = _BASE16384_ENCBUFSZ;
-	size_t cnt = 0;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
-	if(!(flag&BASE16384_FLAG_NOHEADER)) write(output, "\xfe\xff", 2);
+	#if defined BASE16384_SPLICE || defined BASE16384_URING
+		base16384_err_t err;
+	#endif
+	#ifdef BASE16384_SPLICE
+		if(own_bufs && !_base16384_encode_fd_splice(input, output, encbuf, bufsize, flag, &err)) return err;
+	#endif
+	#ifdef BASE16384_URING
+		if(own_bufs && !_base16384_encode_fd_uring(input, output, bufsize, flag, &err)) return err;
+	#endif
+	off_t inputsize = encode_chunk_size(bufsize, flag);
+	ssize_t cnt;
+	int n;
+	base16384_encoder_t enc;
+	base16384_encoder_init(&enc, flag);
+	// the encoder keeps the underfilled group, so each chunk costs one read and one write
 	while((cnt = read(input, encbuf, inputsize)) > 0) {
-		int n;
-		while(cnt%7) {
-			n = read(input, encbuf+cnt, sizeof(char));
-			if(n > 0) cnt++;
-			else break;
-		}
-		if(do_sum_check(flag)) {
-			sum = calc_sum(sum, cnt, encbuf);
-			if(cnt%7) { // last encode
-				*(uint32_t*)(&encbuf[cnt]) = htobe32(sum);
-			}
-		}
-		n = base16384_encode_unsafe(encbuf, cnt, decbuf);
-		if(n && write(output, decbuf, n) < n) {
+		n = base16384_encoder_update(&enc, encbuf, (int)cnt, decbuf);
+		if(n && write(output, decbuf, n) != n) {
 			return base16384_err_write_file;
 		}
 	}
+	if(cnt < 0) {
+		return base16384_err_read_file;
+	}
+	n = base16384_encoder_final(&enc, decbuf);
+	if(n && write(output, decbuf, n) != n) {
+		return base16384_err_write_file;
+	}
 	return base16384_err_ok;
 }
 
+base16384_err_t base16384_encode_fd_ex(int input, int output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
+	return encode_fd(input, output, encbuf, decbuf, flag, bufsize, 1);
+}
+
+// the pipe pages of splice and the slots of io_uring are allocated per call, so a context keeps to its buffers
+base16384_err_t base16384_encode_fd_ctx(int input, int output, base16384_ctx_t* ctx, int flag) {
+	return encode_fd(input, output, ctx->encbuf, ctx->decbuf, flag, ctx->bufsize, 0);
+}
+
 #define call_reader(cd, buf, n) (input->f.reader((cd)->client_data, (buf), (n)))
 #define call_writer(cd, buf, n) (output->f.writer((cd)->client_data, (buf), (n)))
 
-base16384_err_t base16384_encode_stream_detailed(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag) {
+base16384_err_t base16384_encode_stream_ex(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input || !input->f.reader) {
 		return base16384_err_fopen_input_file;
 	}
 	if(!output || !output->f.writer) {
 		return base16384_err_fopen_output_file;
 	}
-	off_t inputsize = _BASE16384_ENCBUFSZ;
-	size_t cnt = 0;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
-	if(!(flag&BASE16384_FLAG_NOHEADER)) call_writer(output, "\xfe\xff", 2);
+	off_t inputsize = encode_chunk_size(bufsize, flag);
+	ssize_t cnt;
+	int n;
+	base16384_encoder_t enc;
+	base16384_encoder_init(&enc, flag);
 	while((cnt = call_reader(input, encbuf, inputsize)) > 0) {
-		ssize_t n;
-		while(cnt%7) {
-			n = call_reader(input, encbuf+cnt, sizeof(char));
-			if(n > 0) cnt++;
-			else break;
-		}
-		if(do_sum_check(flag)) {
-			sum = calc_sum(sum, cnt, encbuf);
-			if(cnt%7) { // last encode
-				*(uint32_t*)(&encbuf[cnt]) = htobe32(sum);
-			}
-		}
-		n = base16384_encode_unsafe(encbuf, cnt, decbuf);
-		if(n && call_writer(output, decbuf, n) < n) {
+		n = base16384_encoder_update(&enc, encbuf, (int)cnt, decbuf);
+		if(n && call_writer(output, decbuf, n) != n) {
 			return base16384_err_write_file;
 		}
 	}
+	if(cnt < 0) {
+		return base16384_err_read_file;
+	}
+	n = base16384_encoder_final(&enc, decbuf);
+	if(n && call_writer(output, decbuf, n) != n) {
+		return base16384_err_write_file;
+	}
 	return base16384_err_ok;
 }
 
-static inline void rm_head(FILE* fp) {
-	int ch = fgetc(fp);
-	if(ch == 0xFE) fgetc(fp);
-	else ungetc(ch, fp);
-}
-
-#define skip_offset(input_file) ((input_file[0]==(char)0xFE)?2:0)
-
-static inline int is_next_end(FILE* fp) {
-	int ch = fgetc(fp);
-	if(ch == EOF) return 0;
-	if(ch == '=') return fgetc(fp);
-	ungetc(ch, fp);
-	return 0;
-}
-
-base16384_err_t base16384_decode_file_detailed(const char* input, const char* output, char* encbuf, char* decbuf, int flag) {
+base16384_err_t base16384_decode_file_ex(const char* input, const char* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input || !output || strlen(input) <= 0 || strlen(output) <= 0) {
 		errno = EINVAL;
 		return base16384_err_invalid_file_name;
@@ -286,7 +552,6 @@ base16384_err_t base16384_decode_file_detailed(const char* input, const char* ou
 	off_t inputsize;
 	FILE* fp = NULL;
 	FILE* fpo;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
 	base16384_err_t retval = base16384_err_ok;
 	int errnobak = 0, is_stdin = is_standard_io(input);
 	if(is_stdin) { // read from stdin
@@ -297,62 +562,59 @@ base16384_err_t base16384_decode_file_detailed(const char* input, const char* ou
 		if(!inputsize) errno = EINVAL;
 		return base16384_err_get_file_size;
 	}
+	#if !defined _WIN32 && !defined __cosmopolitan
+	if(!is_stdin && inputsize >= _BASE16384_DECBUFSZ && !needs_coder(flag) && !is_standard_io(output) && is_mappable_output(output)) { // big file, use mmap & mmap
+		return decode_file_mmap(input, output, inputsize, flag);
+	}
+	#endif
+	#ifdef BASE16384_SPLICE
+	if(is_standard_io(output) && (needs_coder(flag) || inputsize >= _BASE16384_DECBUFSZ) && _base16384_is_pipe(STDOUT_FILENO)) { // stdin or big file into a pipe, vmsplice by the fd way
+		int fd = is_stdin?STDIN_FILENO:open(input, O_RDONLY);
+		if(fd < 0) {
+			return base16384_err_open_input_file;
+		}
+		fflush(stdout);
+		retval = base16384_decode_fd_ex(fd, STDOUT_FILENO, encbuf, decbuf, flag, bufsize);
+		errnobak = errno;
+		if(!is_stdin) close(fd);
+		errno = errnobak;
+		return retval;
+	}
+	#endif
 	fpo = is_standard_io(output)?stdout:fopen(output, "wb");
 	if(!fpo) {
 		return base16384_err_fopen_output_file;
 	}
 	int loop_count = 0;
-	if(inputsize >= _BASE16384_DECBUFSZ) { // stdin or big file, use decbuf & fread
+	if(needs_coder(flag) || inputsize >= _BASE16384_DECBUFSZ || inputsize > read_chunk_size(bufsize, 8)) { // stdin, big file, more than bufsize, trailer or UTF-8, use decbuf & fread
 		if(!is_stdin) loop_count = inputsize/_BASE16384_DECBUFSZ;
-		inputsize = _BASE16384_DECBUFSZ;
+		inputsize = read_chunk_size(bufsize, 8);
 		#if defined _WIN32 || defined __cosmopolitan
 	}
+	if(inputsize > read_chunk_size(bufsize, 8)) inputsize = read_chunk_size(bufsize, 8);	// small file larger than bufsize
 		#endif
 		if(!fp) fp = fopen(input, "rb");
 		if(!fp) {
 			goto_base16384_file_detailed_cleanup(decode, base16384_err_fopen_input_file, {});
 		}
-		rm_head(fp);
-		#ifndef _WIN32 // windows is crazy and always throws EINVAL
-		if(errno) {
-			goto_base16384_file_detailed_cleanup(decode, base16384_err_read_file, {});
-		}
-		#endif
-		int cnt, last_encbuf_cnt = 0, last_decbuf_cnt = 0, offset = 0;
-		size_t total_decoded_len = 0;
+		int cnt, n;
+		base16384_decoder_t dec;
+		base16384_decoder_init(&dec, flag);
 		while((cnt = fread(decbuf, sizeof(char), inputsize, fp)) > 0) {
-			int n;
-			while(cnt%8) {
-				n = fread(decbuf+cnt, sizeof(char), 1, fp);
-				if(n > 0) cnt++;
-				else break;
-			}
-			int end;
-			if((end = is_next_end(fp))) {
-				decbuf[cnt++] = '=';
-				decbuf[cnt++] = end;
-			}
-			#ifndef _WIN32 // windows is crazy and always throws EINVAL
-			if(errno) goto_base16384_file_detailed_cleanup(decode, base16384_err_read_file, {});
-			#endif
-			offset = decbuf[cnt-1];
-			last_decbuf_cnt = cnt;
-			cnt = base16384_decode_unsafe(decbuf, cnt, encbuf);
-			if(cnt && fwrite(encbuf, cnt, 1, fpo) <= 0) {
+			n = base16384_decoder_update(&dec, decbuf, cnt, encbuf);
+			if(n && fwrite(encbuf, n, 1, fpo) <= 0) {
 				goto_base16384_file_detailed_cleanup(decode, base16384_err_write_file, {});
 			}
-			total_decoded_len += cnt;
-			if(do_sum_check(flag)) sum = calc_sum(sum, cnt, encbuf);
-			last_encbuf_cnt = cnt;
 		}
-		if(do_sum_check(flag)
-			&& (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || total_decoded_len >= _BASE16384_ENCBUFSZ)
-			&& last_decbuf_cnt > 2
-			&& decbuf[last_decbuf_cnt-2] == '='
-			&& check_sum(sum, *(uint32_t*)(&encbuf[last_encbuf_cnt]), offset)) {
-			errno = EINVAL;
+		if(ferror(fp)) {
+			goto_base16384_file_detailed_cleanup(decode, base16384_err_read_file, {});
+		}
+		if((n = base16384_decoder_final(&dec, encbuf)) < 0) {
 			goto_base16384_file_detailed_cleanup(decode, base16384_err_invalid_decoding_checksum, {});
 		}
+		if(n && fwrite(encbuf, n, 1, fpo) <= 0) {
+			goto_base16384_file_detailed_cleanup(decode, base16384_err_write_file, {});
+		}
 	#if !defined _WIN32 && !defined __cosmopolitan
 	} else { // small file, use mmap & fwrite
 		int fd = open(input, O_RDONLY);
@@ -382,7 +644,7 @@ base16384_decode_file_detailed_cleanup:
 	return retval;
 }
 
-base16384_err_t base16384_decode_fp_detailed(FILE* input, FILE* output, char* encbuf, char* decbuf, int flag) {
+base16384_err_t base16384_decode_fp_ex(FILE* input, FILE* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input) {
 		errno = EINVAL;
 		return base16384_err_fopen_input_file;
@@ -391,65 +653,30 @@ base16384_err_t base16384_decode_fp_detailed(FILE* input, FILE* output, char* en
 		errno = EINVAL;
 		return base16384_err_fopen_output_file;
 	}
-	off_t inputsize = _BASE16384_DECBUFSZ;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
-	rm_head(input);
-	#ifndef _WIN32 // windows is crazy and always throws EINVAL
-	if(errno) {
-		return base16384_err_read_file;
-	}
-	#endif
-	int cnt, last_encbuf_cnt = 0, last_decbuf_cnt = 0, offset = 0;
-	size_t total_decoded_len = 0;
+	off_t inputsize = read_chunk_size(bufsize, 8);
+	int cnt, n;
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
 	while((cnt = fread(decbuf, sizeof(char), inputsize, input)) > 0) {
-		int n;
-		while(cnt%8) {
-			n = fread(decbuf+cnt, sizeof(char), 1, input);
-			if(n > 0) cnt++;
-			else break;
-		}
-		int end;
-		if((end = is_next_end(input))) {
-			decbuf[cnt++] = '=';
-			decbuf[cnt++] = end;
-		}
-		#ifndef _WIN32 // windows is crazy and always throws EINVAL
-		if(errno) return base16384_err_read_file;
-		#endif
-		offset = decbuf[cnt-1];
-		last_decbuf_cnt = cnt;
-		cnt = base16384_decode_unsafe(decbuf, cnt, encbuf);
-		if(cnt && fwrite(encbuf, cnt, 1, output) <= 0) {
+		n = base16384_decoder_update(&dec, decbuf, cnt, encbuf);
+		if(n && fwrite(encbuf, n, 1, output) <= 0) {
 			return base16384_err_write_file;
 		}
-		total_decoded_len += cnt;
-		if(do_sum_check(flag)) sum = calc_sum(sum, cnt, encbuf);
-		last_encbuf_cnt = cnt;
-	}
-	if(do_sum_check(flag)
-		&& (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || total_decoded_len >= _BASE16384_ENCBUFSZ)
-		&& last_decbuf_cnt > 2
-		&& decbuf[last_decbuf_cnt-2] == '='
-		&& check_sum(sum, *(uint32_t*)(&encbuf[last_encbuf_cnt]), offset)) {
-		errno = EINVAL;
+	}
+	if(ferror(input)) {
+		return base16384_err_read_file;
+	}
+	if((n = base16384_decoder_final(&dec, encbuf)) < 0) {
 		return base16384_err_invalid_decoding_checksum;
 	}
-	return base16384_err_ok;
-}
-
-static inline uint16_t is_next_end_fd(int fd) {
-	uint8_t ch = 0;
-	if(read(fd, &ch, 1) != 1) return (uint16_t)EOF;
-	uint16_t ret = (uint16_t)ch & 0x00ff;
-	if(ch == '=') {
-		if(read(fd, &ch, 1) != 1) return (uint16_t)EOF;
-		ret <<= 8;
-		ret |= (uint16_t)ch & 0x00ff;
+	if(n && fwrite(encbuf, n, 1, output) <= 0) {
+		return base16384_err_write_file;
 	}
-	return ret;
+	return base16384_err_ok;
 }
 
-base16384_err_t base16384_decode_fd_detailed(int input, int output, char* encbuf, char* decbuf, int flag) {
+// splice or io_uring may take buffers of their own if own_bufs, as in base16384_decode_fd_ex
+static base16384_err_t decode_fd(int input, int output, char* encbuf, char* decbuf, int flag, size_t bufsize, int own_bufs) {
 	if(input < 0) {
 		errno = EINVAL;
 		return base16384_err_fopen_input_file;
@@ -458,79 +685,49 @@ base16384_err_t base16384_decode_fd_detailed(int input, int output, char* encbuf
 		errno = EINVAL;
 		return base16384_err_fopen_output_file;
 	}
-
-	off_t inputsize = _BASE16384_DECBUFSZ;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
-	uint8_t remains[8];
-
-	decbuf[0] = 0;
-	if(read(input, remains, 2) != 2) {
-		return base16384_err_read_file;
-	}
-
-	int p = 0;
-	if(remains[0] != (uint8_t)(0xfe)) p = 2;
-
-	int n, last_encbuf_cnt = 0, last_decbuf_cnt = 0, offset = 0;
-	size_t total_decoded_len = 0;
-	while((n = read(input, decbuf+p, inputsize-p)) > 0) {
-		if(p) {
-			memcpy(decbuf, remains, p);
-			n += p;
-			p = 0;
-		}
-		int x;
-		while(n%8) {
-			x = read(input, decbuf+n, sizeof(char));
-			if(x > 0) n++;
-			else break;
-		}
-		uint16_t next = is_next_end_fd(input);
-		#ifndef _WIN32 // windows is crazy and always throws EINVAL
-		if(errno) {
-			return base16384_err_read_file;
-		}
-		#endif
-		if((uint16_t)(~next)) {
-			if(next&0xff00) {
-				decbuf[n++] = '=';
-				decbuf[n++] = (char)(next&0x00ff);
-			} else remains[p++] = (char)(next&0x00ff);
-		}
-		offset = decbuf[n-1];
-		last_decbuf_cnt = n;
-		n = base16384_decode_unsafe(decbuf, n, encbuf);
+	#if defined BASE16384_SPLICE || defined BASE16384_URING
+		base16384_err_t err;
+	#endif
+	#ifdef BASE16384_SPLICE
+		if(own_bufs && !_base16384_decode_fd_splice(input, output, decbuf, bufsize, flag, &err)) return err;
+	#endif
+	#ifdef BASE16384_URING
+		if(own_bufs && !_base16384_decode_fd_uring(input, output, bufsize, flag, &err)) return err;
+	#endif
+	off_t inputsize = read_chunk_size(bufsize, 8);
+	ssize_t cnt;
+	int n;
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	// the decoder holds back the possible `=` remainder, so no lookahead read is needed
+	while((cnt = read(input, decbuf, inputsize)) > 0) {
+		n = base16384_decoder_update(&dec, decbuf, (int)cnt, encbuf);
 		if(n && write(output, encbuf, n) != n) {
 			return base16384_err_write_file;
 		}
-		total_decoded_len += n;
-		if(do_sum_check(flag)) sum = calc_sum(sum, n, encbuf);
-		last_encbuf_cnt = n;
-	}
-	if(do_sum_check(flag)
-		&& (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || total_decoded_len >= _BASE16384_ENCBUFSZ)
-		&& last_decbuf_cnt > 2
-		&& decbuf[last_decbuf_cnt-2] == '='
-		&& check_sum(sum, *(uint32_t*)(&encbuf[last_encbuf_cnt]), offset)) {
-		errno = EINVAL;
+	}
+	if(cnt < 0) {
+		return base16384_err_read_file;
+	}
+	if((n = base16384_decoder_final(&dec, encbuf)) < 0) {
 		return base16384_err_invalid_decoding_checksum;
 	}
+	if(n && write(output, encbuf, n) != n) {
+		return base16384_err_write_file;
+	}
 	return base16384_err_ok;
 }
 
-static inline uint16_t is_next_end_stream(base16384_stream_t* input) {
-	uint8_t ch = 0;
-	if(call_reader(input, &ch, 1) != 1) return (uint16_t)EOF;
-	uint16_t ret = (uint16_t)ch & 0x00ff;
-	if(ch == '=') {
-		if(call_reader(input, &ch, 1) != 1) return (uint16_t)EOF;
-		ret <<= 8;
-		ret |= (uint16_t)ch & 0x00ff;
-	}
-	return ret;
+base16384_err_t base16384_decode_fd_ex(int input, int output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
+	return decode_fd(input, output, encbuf, decbuf, flag, bufsize, 1);
+}
+
+// the pipe pages of splice and the slots of io_uring are allocated per call, so a context keeps to its buffers
+base16384_err_t base16384_decode_fd_ctx(int input, int output, base16384_ctx_t* ctx, int flag) {
+	return decode_fd(input, output, ctx->encbuf, ctx->decbuf, flag, ctx->bufsize, 0);
 }
 
-base16384_err_t base16384_decode_stream_detailed(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag) {
+base16384_err_t base16384_decode_stream_ex(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, size_t bufsize) {
 	if(!input || !input->f.reader) {
 		errno = EINVAL;
 		return base16384_err_fopen_input_file;
@@ -539,62 +736,25 @@ base16384_err_t base16384_decode_stream_detailed(base16384_stream_t* input, base
 		errno = EINVAL;
 		return base16384_err_fopen_output_file;
 	}
-
-	off_t inputsize = _BASE16384_DECBUFSZ;
-	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
-	uint8_t remains[8];
-
-	decbuf[0] = 0;
-	if(call_reader(input, remains, 2) != 2) {
-		return base16384_err_read_file;
-	}
-
-	int p = 0;
-	if(remains[0] != (uint8_t)(0xfe)) p = 2;
-
-	int n, last_encbuf_cnt = 0, last_decbuf_cnt = 0, offset = 0;
-	size_t total_decoded_len = 0;
-	while((n = call_reader(input, decbuf+p, inputsize-p)) > 0) {
-		if(p) {
-			memcpy(decbuf, remains, p);
-			n += p;
-			p = 0;
-		}
-		int x;
-		while(n%8) {
-			x = call_reader(input, decbuf+n, sizeof(char));
-			if(x > 0) n++;
-			else break;
-		}
-		uint16_t next = is_next_end_stream(input);
-		#ifndef _WIN32 // windows is crazy and always throws EINVAL
-		if(errno) {
-			return base16384_err_read_file;
-		}
-		#endif
-		if((uint16_t)(~next)) {
-			if(next&0xff00) {
-				decbuf[n++] = '=';
-				decbuf[n++] = (char)(next&0x00ff);
-			} else remains[p++] = (char)(next&0x00ff);
-		}
-		offset = decbuf[n-1];
-		last_decbuf_cnt = n;
-		n = base16384_decode_unsafe(decbuf, n, encbuf);
+	off_t inputsize = read_chunk_size(bufsize, 8);
+	ssize_t cnt;
+	int n;
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	while((cnt = call_reader(input, decbuf, inputsize)) > 0) {
+		n = base16384_decoder_update(&dec, decbuf, (int)cnt, encbuf);
 		if(n && call_writer(output, encbuf, n) != n) {
 			return base16384_err_write_file;
 		}
-		total_decoded_len += n;
-		if(do_sum_check(flag)) sum = calc_sum(sum, n, encbuf);
-		last_encbuf_cnt = n;
-	}
-	if(do_sum_check(flag)
-		&& (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || total_decoded_len >= _BASE16384_ENCBUFSZ)
-		&& last_decbuf_cnt > 2
-		&& decbuf[last_decbuf_cnt-2] == '='
-		&& check_sum(sum, *(uint32_t*)(&encbuf[last_encbuf_cnt]), offset)) {
-		errno = EINVAL;
+	}
+	if(cnt < 0) {
+		return base16384_err_read_file;
+	}
+	if((n = base16384_decoder_final(&dec, encbuf)) < 0) {
 		return base16384_err_invalid_decoding_checksum;
 	}
+	if(n && call_writer(output, encbuf, n) != n) {
+		return base16384_err_write_file;
+	}
 	return base16384_err_ok;
 }
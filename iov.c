@@ -0,0 +1,156 @@
+/* iov.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WIN32
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+
+/*
+ * The fragments are fed to the push encoder and decoder in place, which
+ * carry the groups and code units split across fragment boundaries, so
+ * the fragments are never copied together.
+*/
+
+#define IOV_CHUNK (1<<30)	// the most bytes given to one update
+
+// walk the fragments by pieces of at most chunk bytes as p and len
+#define for_each_piece(iov, iovcnt, chunk, body) \
+	for(i = 0; i < (iovcnt); i++) { \
+		const char* p = (const char*)(iov)[i].iov_base; \
+		size_t left = (iov)[i].iov_len; \
+		while(left) { \
+			int len = (left > (size_t)(chunk))?(chunk):(int)left; \
+			body \
+			p += len; \
+			left -= len; \
+		} \
+	}
+
+static size_t iov_total(const struct iovec* iov, int iovcnt) {
+	size_t total = 0;
+	int i;
+	for(i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+	return total;
+}
+
+int base16384_encode_iov_len(const struct iovec* iov, int iovcnt) {
+	return _base16384_encode_len((int)iov_total(iov, iovcnt));
+}
+
+int base16384_decode_iov_len(const struct iovec* iov, int iovcnt) {
+	return (int)((iov_total(iov, iovcnt) + 7) / 8 * 7);
+}
+
+int base16384_encode_iov(const struct iovec* iov, int iovcnt, char* buf) {
+	base16384_encoder_t enc;
+	int i, n = 0;
+	base16384_encoder_init(&enc, BASE16384_FLAG_NOHEADER);
+	for_each_piece(iov, iovcnt, IOV_CHUNK, {
+		n += base16384_encoder_update(&enc, p, len, buf+n);
+	});
+	return n + base16384_encoder_final(&enc, buf+n);
+}
+
+int base16384_decode_iov(const struct iovec* iov, int iovcnt, char* buf) {
+	base16384_decoder_t dec;
+	int i, n = 0, m;
+	base16384_decoder_init(&dec, 0);
+	for_each_piece(iov, iovcnt, IOV_CHUNK, {
+		n += base16384_decoder_update(&dec, p, len, buf+n);
+	});
+	if((m = base16384_decoder_final(&dec, buf+n)) < 0) return -1;
+	return n + m;
+}
+
+/*
+ * The coded chunks are collected in decbuf and written once it cannot take
+ * the next one, so small fragments don't cost a write each.
+*/
+
+#define flush_buffer(buf, n) \
+	if((n) && write(output, (buf), (n)) != (n)) { \
+		return base16384_err_write_file; \
+	}
+
+base16384_err_t base16384_encode_iov_fd(const struct iovec* iov, int iovcnt, int output, char* decbuf, int flag, size_t bufsize) {
+	if(output < 0) {
+		errno = EINVAL;
+		return base16384_err_fopen_output_file;
+	}
+	int chunk = encode_chunk_size(bufsize, flag), cap = (int)base16384_decbuf_len(bufsize), i, n = 0;
+	base16384_encoder_t enc;
+	// iov holds the whole input, so the sum is decided like a regular file of this size
+	if(!(flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY) && iov_total(iov, iovcnt) < _BASE16384_ENCBUFSZ) {
+		flag &= ~BASE16384_FLAG_SUM_CHECK_ON_REMAIN;
+	}
+	base16384_encoder_init(&enc, flag);
+	for_each_piece(iov, iovcnt, chunk, {
+		int need = base16384_encoder_update_len(len);
+		if(is_utf8(flag)) need = base16384_utf8_len(need);
+		if(n + need > cap) {
+			flush_buffer(decbuf, n);
+			n = 0;
+		}
+		n += base16384_encoder_update(&enc, p, len, decbuf+n);
+	});
+	if(n + BASE16384_ENCODER_FINAL_LEN > cap) {
+		flush_buffer(decbuf, n);
+		n = 0;
+	}
+	n += base16384_encoder_final(&enc, decbuf+n);
+	flush_buffer(decbuf, n);
+	return base16384_err_ok;
+}
+
+base16384_err_t base16384_decode_iov_fd(const struct iovec* iov, int iovcnt, int output, char* encbuf, int flag, size_t bufsize) {
+	if(output < 0) {
+		errno = EINVAL;
+		return base16384_err_fopen_output_file;
+	}
+	int chunk = read_chunk_size(bufsize, 8), cap = (int)base16384_encbuf_len(bufsize), i, n = 0, m;
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	for_each_piece(iov, iovcnt, chunk, {
+		if(n + base16384_decoder_update_len(len) > cap) {
+			flush_buffer(encbuf, n);
+			n = 0;
+		}
+		n += base16384_decoder_update(&dec, p, len, encbuf+n);
+	});
+	if(n + BASE16384_DECODER_FINAL_LEN > cap) {
+		flush_buffer(encbuf, n);
+		n = 0;
+	}
+	if((m = base16384_decoder_final(&dec, encbuf+n)) < 0) {
+		return base16384_err_invalid_decoding_checksum;
+	}
+	n += m;
+	flush_buffer(encbuf, n);
+	return base16384_err_ok;
+}
+
+#endif
@@ -0,0 +1,852 @@
+/* parallel.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _MSC_VER
+#ifndef _CRT_SECURE_NO_WARNINGS
+	#define _CRT_SECURE_NO_WARNINGS
+#endif
+#endif
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE	// sched_getaffinity
+#endif
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <pthread.h>
+	#ifdef __linux__
+		#include <sched.h>
+	#endif
+#endif
+#endif
+#include "base16384.h"
+#include "binary.h"
+
+#if !defined _WIN32 && !defined __cosmopolitan
+	#define BASE16384_PARALLEL
+#endif
+
+#ifdef __linux__
+// the cpus allowed by cgroup v2 cpu.max or v1 cfs quota, 0 if unlimited
+static int cgroup_cpu_limit() {
+	long long quota = -1, period = 0;
+	FILE* fp = fopen("/sys/fs/cgroup/cpu.max", "r");
+	if(fp) { // "max 100000" fails the scan and means unlimited
+		if(fscanf(fp, "%lld %lld", &quota, &period) != 2) quota = -1;
+		fclose(fp);
+	} else {
+		fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+		if(fp) {
+			if(fscanf(fp, "%lld", &quota) != 1) quota = -1;
+			fclose(fp);
+		}
+		fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+		if(fp) {
+			if(fscanf(fp, "%lld", &period) != 1) period = 0;
+			fclose(fp);
+		}
+	}
+	if(quota <= 0 || period <= 0) return 0;
+	return (int)((quota + period - 1) / period);
+}
+#endif
+
+int base16384_get_nproc() {
+	int n = 1;
+	#if defined _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		n = (int)info.dwNumberOfProcessors;
+	#elif defined __linux__
+		cpu_set_t set;
+		if(!sched_getaffinity(0, sizeof(set), &set)) n = CPU_COUNT(&set);
+		else n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		int limit = cgroup_cpu_limit();
+		if(limit > 0 && limit < n) n = limit;
+	#elif !defined __cosmopolitan
+		n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	#endif
+	return (n > 0)?n:1;
+}
+
+#ifdef BASE16384_PARALLEL
+
+#define is_standard_io(filename) (*(uint16_t*)(filename) == *(uint16_t*)"-")
+
+struct base16384_worker_t {
+	pthread_t tid;
+	int started;
+	int input, output;
+	int id, nworkers;
+	int is_encode;
+	size_t ngroups;		// full groups of the whole file
+	size_t slice;		// groups per slice, which fit in encbuf and decbuf
+	off_t inoff, outoff;	// where the groups start in input and output
+	char *inbuf, *outbuf;
+	base16384_err_t err;
+	int errnum;
+};
+typedef struct base16384_worker_t base16384_worker_t;
+
+// groups per slice for bufsize
+#define slice_groups(bufsize, is_encode) ((size_t)read_chunk_size(bufsize, (is_encode)?7:8)/((is_encode)?7:8))
+
+#define worker_error(reason) { \
+	w->err = reason; \
+	w->errnum = errno; \
+	return NULL; \
+}
+
+// worker k codes slices k, k+n, k+2n... and writes each one at its own offset
+static void* base16384_worker(void* arg) {
+	base16384_worker_t* w = (base16384_worker_t*)arg;
+	size_t slice = w->slice;
+	size_t inunit = w->is_encode?7:8, outunit = w->is_encode?8:7;
+	size_t s;
+	for(s = w->id*slice; s < w->ngroups; s += w->nworkers*slice) {
+		size_t n = w->ngroups - s;
+		if(n > slice) n = slice;
+		if(pread_full(w->input, w->inbuf, n*inunit, w->inoff + (off_t)(s*inunit))) {
+			worker_error(base16384_err_read_file);
+		}
+		int m = w->is_encode
+			?base16384_encode_safe(w->inbuf, (int)(n*inunit), w->outbuf)
+			:base16384_decode_safe(w->inbuf, (int)(n*inunit), w->outbuf);
+		if(pwrite_full(w->output, w->outbuf, m, w->outoff + (off_t)(s*outunit))) {
+			worker_error(base16384_err_write_file);
+		}
+	}
+	return NULL;
+}
+
+#undef worker_error
+
+// run the workers over ngroups full groups and wait for them
+static base16384_err_t run_workers(base16384_worker_t* proto, int threads, char* encbuf, char* decbuf, int* errnum) {
+	size_t slice = proto->slice;
+	size_t nslices = (proto->ngroups + slice - 1) / slice;
+	size_t halfsize = base16384_decbuf_len(slice*8);	// both the input and the output of a slice fit in
+	if((size_t)threads > nslices) threads = (int)nslices;
+	base16384_worker_t* workers = (base16384_worker_t*)calloc(threads, sizeof(base16384_worker_t));
+	if(!workers) {
+		workers = proto;
+		threads = 1;
+	}
+	int i;
+	for(i = 0; i < threads; i++) {
+		base16384_worker_t* w = &workers[i];
+		if(w != proto) *w = *proto;
+		w->id = i; w->nworkers = threads;
+		w->inbuf = (char*)malloc(halfsize*2);
+		if(!w->inbuf) continue;
+		w->outbuf = w->inbuf + halfsize;
+		if(!pthread_create(&w->tid, NULL, base16384_worker, w)) w->started = 1;
+	}
+	base16384_err_t err = base16384_err_ok;
+	for(i = 0; i < threads; i++) {
+		base16384_worker_t* w = &workers[i];
+		if(w->started) pthread_join(w->tid, NULL);
+		else { // no more memory or thread, run it on the caller's buffers
+			char* buf = w->inbuf;
+			w->inbuf = proto->is_encode?encbuf:decbuf;
+			w->outbuf = proto->is_encode?decbuf:encbuf;
+			base16384_worker(w);
+			w->inbuf = buf;
+		}
+		if(w->inbuf) free(w->inbuf);
+		if(!err && w->err) {
+			err = w->err;
+			*errnum = w->errnum;
+		}
+	}
+	if(workers != proto) free(workers);
+	return err;
+}
+
+/*
+ * The leaves of BASE16384_FLAG_CRC_TREE hash blocks of their own, so they are
+ * hashed by threads like the slices, from the data in the files or from the
+ * code decoded block by block when only verifying.
+*/
+
+struct base16384_leaf_worker_t {
+	pthread_t tid;
+	int started;
+	int fd;
+	int is_coded;		// decode each block of fd before hashing it
+	off_t off;			// where the blocks start in fd
+	size_t len;			// the length of the blocks in fd
+	size_t id, nworkers;
+	uint32_t* leaves;
+	int err;			// errno of the failure, or 0
+};
+typedef struct base16384_leaf_worker_t base16384_leaf_worker_t;
+
+#define CODED_TREE_BLOCK (BASE16384_CRC_TREE_BLOCK/7*8)
+
+// the leaves in len bytes, where a coded `=` with its offset alone past the last block belongs to it
+static inline size_t leaves_of(size_t len, int is_coded) {
+	size_t unit = is_coded?CODED_TREE_BLOCK:BASE16384_CRC_TREE_BLOCK;
+	if(is_coded && len > unit && len%unit == 2) len -= 2;
+	return (len + unit - 1) / unit;
+}
+
+// worker k hashes the leaves k, k+n, k+2n...
+static void* base16384_leaf_worker(void* arg) {
+	base16384_leaf_worker_t* w = (base16384_leaf_worker_t*)arg;
+	size_t unit = w->is_coded?CODED_TREE_BLOCK:BASE16384_CRC_TREE_BLOCK;
+	size_t nleaves = leaves_of(w->len, w->is_coded), b;
+	char* buf = (char*)malloc(BASE16384_CRC_TREE_BLOCK + (w->is_coded?CODED_TREE_BLOCK+16:0));
+	if(!buf) {
+		w->err = ENOMEM;
+		return NULL;
+	}
+	char* in = w->is_coded?(buf+BASE16384_CRC_TREE_BLOCK):buf;
+	for(b = w->id; b < nleaves; b += w->nworkers) {
+		size_t n = w->len - b*unit;
+		if(n > unit && b+1 < nleaves) n = unit;
+		if(pread_full(w->fd, in, n, w->off + (off_t)(b*unit))) {
+			w->err = errno;
+			break;
+		}
+		if(w->is_coded) n = (size_t)base16384_decode_safe(in, (int)n, buf);
+		w->leaves[b] = base16384_crc32c(0, buf, n);
+	}
+	free(buf);
+	return NULL;
+}
+
+// hash the leaves of len bytes at off in fd by threads, returning the count or -1
+static ssize_t hash_leaves(int fd, off_t off, size_t len, int is_coded, int threads, uint32_t* leaves) {
+	size_t nleaves = leaves_of(len, is_coded);
+	if((size_t)threads > nleaves) threads = nleaves?(int)nleaves:1;
+	base16384_leaf_worker_t proto = {
+		.fd = fd, .is_coded = is_coded, .off = off, .len = len, .nworkers = 1, .leaves = leaves,
+	};
+	base16384_leaf_worker_t* workers = (base16384_leaf_worker_t*)calloc(threads, sizeof(base16384_leaf_worker_t));
+	if(!workers) {
+		workers = &proto;
+		threads = 1;
+	}
+	int i, err = 0;
+	for(i = 0; i < threads; i++) {
+		base16384_leaf_worker_t* w = &workers[i];
+		if(w != &proto) *w = proto;
+		w->id = i; w->nworkers = threads;
+		if(!pthread_create(&w->tid, NULL, base16384_leaf_worker, w)) w->started = 1;
+	}
+	for(i = 0; i < threads; i++) {
+		base16384_leaf_worker_t* w = &workers[i];
+		if(w->started) pthread_join(w->tid, NULL);
+		else base16384_leaf_worker(w);	// no more thread, run it on the caller
+		if(!err) err = w->err;
+	}
+	if(workers != &proto) free(workers);
+	if(err) {
+		errno = err;
+		return -1;
+	}
+	return (ssize_t)nleaves;
+}
+
+// set the tree of a coder to that of the len bytes at the start of fd
+#define hash_coder_tree(coder, fd, len, threads) ( \
+	(nleaves = hash_leaves(fd, 0, len, 0, threads, leaves)) < 0?-1:( \
+		(coder).leaf_len = (len)%BASE16384_CRC_TREE_BLOCK, \
+		(coder).crc = (coder).leaf_len?leaves[nleaves-1]:0, \
+		(coder).root = base16384_crc_tree_root(leaves, (coder).leaf_len?nleaves-1:nleaves), \
+		0 \
+	) \
+)
+
+#define tree_leaves_of(len) (((len) + BASE16384_CRC_TREE_BLOCK - 1) / BASE16384_CRC_TREE_BLOCK)
+
+#define goto_base16384_parallel_cleanup(method, reason) { \
+	errnobak = errno; \
+	retval = reason; \
+	goto base16384_##method##_file_parallel_cleanup; \
+}
+
+static base16384_err_t encode_file_parallel(int input, int output, off_t inputsize, char* encbuf, char* decbuf, int flag, int threads, size_t bufsize) {
+	base16384_err_t retval = base16384_err_ok;
+	int errnobak = 0;
+	uint32_t* leaves = NULL;
+	ssize_t nleaves;
+	size_t ngroups = (size_t)inputsize / 7;
+	off_t h = (flag&BASE16384_FLAG_NOHEADER)?0:2;
+	if(h && pwrite_full(output, "\xfe\xff", 2, 0)) {
+		goto_base16384_parallel_cleanup(encode, base16384_err_write_file);
+	}
+	base16384_worker_t proto = {
+		.input = input, .output = output, .is_encode = 1,
+		.ngroups = ngroups, .slice = slice_groups(bufsize, 1), .inoff = 0, .outoff = h,
+	};
+	retval = run_workers(&proto, threads, encbuf, decbuf, &errnobak);
+	if(retval) goto base16384_encode_file_parallel_cleanup;
+	// the remainder and its checksum follow all the groups
+	base16384_encoder_t enc;
+	base16384_encoder_init(&enc, flag|BASE16384_FLAG_NOHEADER);
+	if(flag&BASE16384_FLAG_CRC_TREE) {
+		leaves = (uint32_t*)malloc(tree_leaves_of(ngroups*7)*sizeof(uint32_t)+1);
+		if(!leaves) {
+			errno = ENOMEM;
+			goto_base16384_parallel_cleanup(encode, base16384_err_read_file);
+		}
+		if(hash_coder_tree(enc, input, ngroups*7, threads)) {
+			goto_base16384_parallel_cleanup(encode, base16384_err_read_file);
+		}
+	}
+	int remain = (int)(inputsize - ngroups*7);
+	if(pread_full(input, encbuf, remain, ngroups*7)) {
+		goto_base16384_parallel_cleanup(encode, base16384_err_read_file);
+	}
+	int n = base16384_encoder_update(&enc, encbuf, remain, decbuf);
+	n += base16384_encoder_final(&enc, decbuf+n);
+	if(pwrite_full(output, decbuf, n, h + (off_t)(ngroups*8))) {
+		goto_base16384_parallel_cleanup(encode, base16384_err_write_file);
+	}
+base16384_encode_file_parallel_cleanup:
+	if(leaves) free(leaves);
+	if(errnobak) errno = errnobak;
+	return retval;
+}
+
+static base16384_err_t decode_file_parallel(int input, int output, off_t inputsize, char* encbuf, char* decbuf, int flag, int threads, size_t bufsize) {
+	base16384_err_t retval = base16384_err_ok;
+	int errnobak = 0;
+	uint32_t* leaves = NULL;
+	ssize_t nleaves;
+	if(pread_full(input, decbuf, 2, 0)) {
+		goto_base16384_parallel_cleanup(decode, base16384_err_read_file);
+	}
+	off_t h = (decbuf[0] == (char)0xFE && decbuf[1] == (char)0xFF)?2:0;
+	size_t len = (size_t)(inputsize - h);
+	// like base16384_decoder_t, the last 2~10 bytes may contain the remainder, and the trailer follows
+	size_t hold = 10 + (has_trailer(flag)?BASE16384_CRC32C_TRAILER_LEN:0);
+	size_t ngroups = (len > hold)?(len-hold+7)/8:0;
+	base16384_worker_t proto = {
+		.input = input, .output = output, .is_encode = 0,
+		.ngroups = ngroups, .slice = slice_groups(bufsize, 0), .inoff = h, .outoff = 0,
+	};
+	retval = run_workers(&proto, threads, encbuf, decbuf, &errnobak);
+	if(retval) goto base16384_decode_file_parallel_cleanup;
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	dec.header_pending = 0;
+	dec.total = ngroups*7;
+	if(flag&BASE16384_FLAG_CRC_TREE) {
+		leaves = (uint32_t*)malloc(tree_leaves_of(ngroups*7)*sizeof(uint32_t)+1);
+		if(!leaves) {
+			errno = ENOMEM;
+			goto_base16384_parallel_cleanup(decode, base16384_err_read_file);
+		}
+		if(hash_coder_tree(dec, output, ngroups*7, threads)) {
+			goto_base16384_parallel_cleanup(decode, base16384_err_read_file);
+		}
+	}
+	int remain = (int)(len - ngroups*8);
+	if(pread_full(input, decbuf, remain, h + (off_t)(ngroups*8))) {
+		goto_base16384_parallel_cleanup(decode, base16384_err_read_file);
+	}
+	int n = base16384_decoder_update(&dec, decbuf, remain, encbuf);
+	int x = base16384_decoder_final(&dec, encbuf+n);
+	if(x < 0) {
+		goto_base16384_parallel_cleanup(decode, base16384_err_invalid_decoding_checksum);
+	}
+	if(pwrite_full(output, encbuf, n+x, (off_t)(ngroups*7))) {
+		goto_base16384_parallel_cleanup(decode, base16384_err_write_file);
+	}
+base16384_decode_file_parallel_cleanup:
+	if(leaves) free(leaves);
+	if(errnobak) errno = errnobak;
+	return retval;
+}
+
+#undef goto_base16384_parallel_cleanup
+
+// verify the tree trailer of fd, which holds len bytes after h
+static base16384_err_t verify_fd(int fd, off_t h, size_t len, int threads, const uint32_t* leaves, ssize_t* badblock) {
+	char trailer[BASE16384_CRC32C_TRAILER_LEN];
+	if(len < BASE16384_CRC32C_TRAILER_LEN) {
+		errno = EINVAL;
+		return base16384_err_invalid_decoding_checksum;
+	}
+	len -= BASE16384_CRC32C_TRAILER_LEN;
+	if(pread_full(fd, trailer, BASE16384_CRC32C_TRAILER_LEN, h + (off_t)len)) return base16384_err_read_file;
+	uint32_t* got = (uint32_t*)malloc((len/CODED_TREE_BLOCK+1)*sizeof(uint32_t));
+	if(!got) {
+		errno = ENOMEM;
+		return base16384_err_read_file;
+	}
+	ssize_t n = hash_leaves(fd, h, len, 1, threads, got), i;
+	if(n < 0) {
+		int errnobak = errno;
+		free(got);
+		errno = errnobak;
+		return base16384_err_read_file;
+	}
+	if(leaves && badblock) for(i = 0; i < n; i++) if(got[i] != leaves[i]) {
+		*badblock = i;
+		break;
+	}
+	int bad = check_crc(trailer, base16384_crc_tree_root(got, n));
+	free(got);
+	if(bad) {
+		errno = EINVAL;
+		return base16384_err_invalid_decoding_checksum;
+	}
+	return base16384_err_ok;
+}
+
+// open regular files worth more than one slice per thread, or else return -1 to fall back
+static int open_parallel(const char* input, const char* output, int is_encode, size_t bufsize, int* fdi, int* fdo, off_t* inputsize) {
+	if(is_standard_io(input) || is_standard_io(output)) return -1;
+	struct stat st;
+	*fdi = open(input, O_RDONLY);
+	if(*fdi < 0) return -1;
+	size_t slice = slice_groups(bufsize, is_encode)*(is_encode?7:8);
+	size_t big = is_encode?_BASE16384_ENCBUFSZ:_BASE16384_DECBUFSZ;
+	if(slice < big) slice = big;	// smaller files go without the sum in the remainder
+	if(fstat(*fdi, &st) || !S_ISREG(st.st_mode) || (size_t)st.st_size < slice*2) {
+		close(*fdi);
+		return -1;
+	}
+	*inputsize = st.st_size;
+	*fdo = open(output, O_RDWR|O_CREAT|O_TRUNC, 0666);
+	if(*fdo < 0) {
+		close(*fdi);
+		return -1;
+	}
+	if(fstat(*fdo, &st) || !S_ISREG(st.st_mode)) {
+		close(*fdi);
+		close(*fdo);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The stream pipeline: the reader fills chunk seq into slot seq%depth, the
+ * workers claim the published chunks in turn and the writer takes them back
+ * in order. Each ring is a counter moved by one side only and read by the
+ * others, published by the reader, claimed by the workers and written by the
+ * writer, so no lock is taken while there is work to do. A thread that has to
+ * wait sleeps on an event count instead of spinning.
+*/
+
+struct base16384_chunk_t {
+	char *in, *out;
+	int inlen, outlen;
+	int last;	// coded by the writer, who holds the sum
+	int done;	// coded by a worker
+};
+typedef struct base16384_chunk_t base16384_chunk_t;
+
+struct base16384_pipeline_t {
+	base16384_stream_t *input;
+	int is_encode, depth;
+	int size;	// the bytes read into a chunk
+	base16384_chunk_t* chunks;
+	unsigned long published, claimed, written;
+	int finished;	// the last chunk is published
+	int aborted;	// the writer has failed
+	base16384_err_t readerr;
+	int errnum;
+	pthread_mutex_t mu;
+	pthread_cond_t cv;
+	int waiters;
+};
+typedef struct base16384_pipeline_t base16384_pipeline_t;
+
+#define load(x) __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define store(x, v) __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+
+static void pipeline_signal(base16384_pipeline_t* p) {
+	if(load(p->waiters)) {
+		pthread_mutex_lock(&p->mu);
+		pthread_cond_broadcast(&p->cv);
+		pthread_mutex_unlock(&p->mu);
+	}
+}
+
+// the waiter counts itself before checking cond, so that a signal after cond changes never misses it
+#define pipeline_wait(p, cond) if(!(cond)) { \
+	pthread_mutex_lock(&(p)->mu); \
+	__atomic_fetch_add(&(p)->waiters, 1, __ATOMIC_SEQ_CST); \
+	while(!(cond)) pthread_cond_wait(&(p)->cv, &(p)->mu); \
+	__atomic_fetch_sub(&(p)->waiters, 1, __ATOMIC_SEQ_CST); \
+	pthread_mutex_unlock(&(p)->mu); \
+}
+
+// read until the chunk has size bytes or the input ends
+static int fill_chunk(base16384_pipeline_t* p, base16384_chunk_t* c, int size) {
+	while(c->inlen < size) {
+		ssize_t n = p->input->f.reader(p->input->client_data, c->in+c->inlen, size-c->inlen);
+		if(n < 0) return -1;
+		if(!n) break;
+		c->inlen += (int)n;
+	}
+	return 0;
+}
+
+static void* pipeline_reader(void* arg) {
+	base16384_pipeline_t* p = (base16384_pipeline_t*)arg;
+	int size = p->size;
+	unsigned long seq = 0;
+	base16384_chunk_t *c = &p->chunks[0], *next;
+	int err = 0;
+	c->inlen = 0;
+	if(!p->is_encode) { // strip the header so that every chunk holds whole groups
+		err = fill_chunk(p, c, 2);
+		if(!err && c->inlen == 2 && c->in[0] == (char)0xFE && c->in[1] == (char)0xFF) c->inlen = 0;
+	}
+	if(!err) err = fill_chunk(p, c, size);
+	while(!err && c->inlen == size) {
+		// only a full chunk followed by more data can leave its remainder to others
+		pipeline_wait(p, load(p->written)+p->depth > seq+1 || load(p->aborted));
+		if(load(p->aborted)) break;
+		next = &p->chunks[(seq+1)%p->depth];
+		next->inlen = 0;
+		if((err = fill_chunk(p, next, size)) || !next->inlen) break;
+		if(!p->is_encode && next->inlen < 10) {
+			// like base16384_decoder_t, the last 2~10 bytes may hold the remainder, then carry their groups on
+			int m = (10-next->inlen+7)/8*8;
+			memmove(next->in+m, next->in, next->inlen);
+			memcpy(next->in, c->in+c->inlen-m, m);
+			next->inlen += m;
+			c->inlen -= m;
+		}
+		c->last = 0;
+		store(p->published, seq+1);
+		pipeline_signal(p);
+		c = next;
+		seq++;
+	}
+	if(err) {
+		p->readerr = base16384_err_read_file;
+		p->errnum = errno;
+	}
+	c->last = 1;
+	store(p->published, seq+1);
+	store(p->finished, 1);
+	pipeline_signal(p);
+	return NULL;
+}
+
+static void* pipeline_worker(void* arg) {
+	base16384_pipeline_t* p = (base16384_pipeline_t*)arg;
+	for(;;) {
+		unsigned long seq = __atomic_fetch_add(&p->claimed, 1, __ATOMIC_SEQ_CST);
+		pipeline_wait(p, load(p->published) > seq || load(p->finished));
+		if(load(p->published) <= seq) break;
+		base16384_chunk_t* c = &p->chunks[seq%p->depth];
+		if(!c->last) c->outlen = p->is_encode
+			?base16384_encode_safe(c->in, c->inlen, c->out)
+			:base16384_decode_safe(c->in, c->inlen, c->out);
+		store(c->done, 1);
+		pipeline_signal(p);
+	}
+	return NULL;
+}
+
+// the last chunk carries the remainder and the sum, which need all the chunks before
+static int code_last_chunk(base16384_pipeline_t* p, base16384_chunk_t* c, int flag, uint32_t sum, size_t total) {
+	if(p->is_encode) {
+		base16384_encoder_t enc;
+		base16384_encoder_init(&enc, flag|BASE16384_FLAG_NOHEADER);
+		enc.sum = sum;
+		int n = base16384_encoder_update(&enc, c->in, c->inlen, c->out);
+		return n + base16384_encoder_final(&enc, c->out+n);
+	}
+	base16384_decoder_t dec;
+	base16384_decoder_init(&dec, flag);
+	dec.header_pending = 0;
+	dec.sum = sum;
+	dec.total = total;
+	int n = base16384_decoder_update(&dec, c->in, c->inlen, c->out);
+	int x = base16384_decoder_final(&dec, c->out+n);
+	return (x < 0)?-1:n+x;
+}
+
+// take the chunks back in order on the caller's thread, only draining them after an error
+static base16384_err_t pipeline_writer(base16384_pipeline_t* p, base16384_stream_t* output, int flag) {
+	base16384_err_t err = base16384_err_ok;
+	int errnobak = 0;
+	uint32_t sum = BASE16384_SIMPLE_SUM_INIT_VALUE;
+	size_t total = 0;
+	unsigned long seq;
+	if(p->is_encode && !(flag&BASE16384_FLAG_NOHEADER) && output->f.writer(output->client_data, "\xfe\xff", 2) != 2) {
+		err = base16384_err_write_file;
+		errnobak = errno;
+		store(p->aborted, 1);
+	}
+	for(seq = 0;; seq++) {
+		base16384_chunk_t* c = &p->chunks[seq%p->depth];
+		pipeline_wait(p, load(c->done));
+		store(c->done, 0);
+		int last = c->last, n = c->outlen;
+		if(!err && last && p->readerr) {
+			err = p->readerr;
+			errnobak = p->errnum;
+		}
+		if(!err) {
+			if(last) n = code_last_chunk(p, c, flag, sum, total);
+			else {
+				if(do_sum_check(flag)) sum = p->is_encode?calc_sum(sum, c->inlen, c->in):calc_sum(sum, c->outlen, c->out);
+				total += c->outlen;
+			}
+			if(n < 0) err = base16384_err_invalid_decoding_checksum;
+			else if(n && output->f.writer(output->client_data, c->out, n) != n) {
+				err = base16384_err_write_file;
+				errnobak = errno;
+			}
+			if(err) store(p->aborted, 1);
+		}
+		store(p->written, seq+1);
+		pipeline_signal(p);
+		if(last) break;
+	}
+	if(errnobak) errno = errnobak;
+	return err;
+}
+
+// 0 if the pipeline has run, or -1 if no thread can start and nothing is touched
+static int code_stream_pipeline(base16384_stream_t* input, base16384_stream_t* output, int flag, int is_encode, int threads, int depth, size_t bufsize, base16384_err_t* err) {
+	if(depth <= 0) depth = threads*2;
+	if(depth < 2) depth = 2;	// the reader holds one chunk while filling the next
+	int size = read_chunk_size(bufsize, is_encode?7:8);
+	if(!is_encode && size < 16) size = 16;	// room for the groups carried to the last chunk
+	size_t insize = (size_t)size+16;
+	size_t outsize = is_encode
+		?base16384_encoder_update_len(size)+BASE16384_ENCODER_FINAL_LEN
+		:base16384_decoder_update_len(size)+BASE16384_DECODER_FINAL_LEN;
+	base16384_pipeline_t p;
+	memset(&p, 0, sizeof(p));
+	p.input = input;
+	p.is_encode = is_encode;
+	p.depth = depth;
+	p.size = size;
+	p.chunks = (base16384_chunk_t*)calloc(depth, sizeof(base16384_chunk_t));
+	pthread_t* tids = (pthread_t*)malloc((threads+1)*sizeof(pthread_t));
+	char* bufs = (char*)malloc((insize+outsize)*depth);
+	if(!p.chunks || !tids || !bufs) {
+		if(p.chunks) free(p.chunks);
+		if(tids) free(tids);
+		if(bufs) free(bufs);
+		return -1;
+	}
+	int i, n = 0;
+	for(i = 0; i < depth; i++) {
+		p.chunks[i].in = bufs + (insize+outsize)*i;
+		p.chunks[i].out = p.chunks[i].in + insize;
+	}
+	pthread_mutex_init(&p.mu, NULL);
+	pthread_cond_init(&p.cv, NULL);
+	for(i = 0; i < threads; i++) {
+		if(!pthread_create(&tids[n], NULL, pipeline_worker, &p)) n++;
+	}
+	int started = n && !pthread_create(&tids[n], NULL, pipeline_reader, &p);
+	if(started) {
+		*err = pipeline_writer(&p, output, flag);
+		n++;
+	} else store(p.finished, 1);	// let the workers go
+	int errnobak = errno;
+	pipeline_signal(&p);
+	for(i = 0; i < n; i++) pthread_join(tids[i], NULL);
+	pthread_cond_destroy(&p.cv);
+	pthread_mutex_destroy(&p.mu);
+	free(bufs);
+	free(tids);
+	free(p.chunks);
+	errno = errnobak;
+	return started?0:-1;
+}
+
+#undef load
+#undef store
+#undef pipeline_wait
+
+static ssize_t fd_reader(const void* client_data, void* buf, size_t count) {
+	ssize_t n;
+	while((n = read((int)(uintptr_t)client_data, buf, count)) < 0 && errno == EINTR);
+	return n;
+}
+
+static ssize_t fd_writer(const void* client_data, const void* buf, size_t count) {
+	return write_full((int)(uintptr_t)client_data, (const char*)buf, count)?-1:(ssize_t)count;
+}
+
+/*
+ * stdin, or stdout after a big file, can only be coded in order, then pipeline them.
+ * So are big files with the sum, which chains all the data in order and cannot be
+ * split into slices, so that the writer sums the chunks while the workers code ahead.
+*/
+static int open_pipeline(const char* input, const char* output, int is_encode, int flag, int* fdi, int* fdo) {
+	if(!is_standard_io(input)) {
+		struct stat st;
+		size_t big = is_encode?_BASE16384_ENCBUFSZ:_BASE16384_DECBUFSZ;
+		if(!(is_standard_io(output) || do_sum_check(flag)) || stat(input, &st)) return -1;
+		if(!(is_encode && (flag&BASE16384_FLAG_DO_SUM_CHECK_FORCELY)) && (size_t)st.st_size < big) return -1;
+	}
+	*fdi = is_standard_io(input)?STDIN_FILENO:open(input, O_RDONLY);
+	if(*fdi < 0) return -1;
+	if(is_standard_io(output)) {
+		fflush(stdout);
+		*fdo = STDOUT_FILENO;
+	} else *fdo = open(output, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if(*fdo < 0) {
+		if(*fdi != STDIN_FILENO) close(*fdi);
+		return -1;
+	}
+	return 0;
+}
+
+#endif
+
+#ifdef BASE16384_PARALLEL
+	#define try_parallel(method) { \
+		int fdi, fdo; \
+		off_t inputsize; \
+		if(threads > 1 && (!has_trailer(flag) || flag&BASE16384_FLAG_CRC_TREE) && !is_utf8(flag) && !do_sum_check(flag) && input && output && *input && *output \
+			&& !open_parallel(input, output, *#method == 'e', bufsize, &fdi, &fdo, &inputsize)) { \
+			base16384_err_t err = method##_file_parallel(fdi, fdo, inputsize, encbuf, decbuf, flag, threads, bufsize); \
+			int errnobak = errno; \
+			close(fdi); \
+			close(fdo); \
+			errno = errnobak; \
+			return err; \
+		} \
+	}
+	#define try_pipeline(method) { \
+		int fdi, fdo; \
+		if(threads > 1 && !needs_coder(flag) && input && output && *input && *output \
+			&& !open_pipeline(input, output, *#method == 'e', flag, &fdi, &fdo)) { \
+			base16384_err_t err = base16384_##method##_stream_parallel_ex(&(base16384_stream_t){ \
+				.client_data = (void*)(uintptr_t)fdi, \
+				.f.reader = fd_reader, \
+			}, &(base16384_stream_t){ \
+				.client_data = (void*)(uintptr_t)fdo, \
+				.f.writer = fd_writer, \
+			}, encbuf, decbuf, flag, threads, 0, bufsize); \
+			int errnobak = errno; \
+			if(fdi != STDIN_FILENO) close(fdi); \
+			if(fdo != STDOUT_FILENO) close(fdo); \
+			errno = errnobak; \
+			return err; \
+		} \
+	}
+	#define try_stream_pipeline(method) { \
+		base16384_err_t err; \
+		if(threads > 0 && !needs_coder(flag) && !code_stream_pipeline(input, output, flag, *#method == 'e', threads, depth, bufsize, &err)) return err; \
+	}
+#else
+	#define try_parallel(method) (void)threads
+	#define try_pipeline(method)
+	#define try_stream_pipeline(method) (void)threads; (void)depth
+#endif
+
+base16384_err_t base16384_verify_file_parallel(const char* input, int threads, const uint32_t* leaves, ssize_t* badblock) {
+	if(badblock) *badblock = -1;
+	if(!input || !*input) {
+		errno = EINVAL;
+		return base16384_err_invalid_file_name;
+	}
+	#ifdef BASE16384_PARALLEL
+		struct stat st;
+		char header[2];
+		int fd = open(input, O_RDONLY);
+		if(fd < 0) return base16384_err_open_input_file;
+		base16384_err_t err = base16384_err_get_file_size;
+		if(fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size < 2) errno = EINVAL;
+		else if(pread_full(fd, header, 2, 0)) err = base16384_err_read_file;
+		else {
+			off_t h = (header[0] == (char)0xFE && header[1] == (char)0xFF)?2:0;
+			err = verify_fd(fd, h, (size_t)(st.st_size - h), (threads > 0)?threads:1, leaves, badblock);
+		}
+		int errnobak = errno;
+		close(fd);
+		errno = errnobak;
+		return err;
+	#else
+		(void)threads; (void)leaves;
+		errno = ENOSYS;
+		return base16384_err_open_input_file;
+	#endif
+}
+
+base16384_err_t base16384_encode_file_parallel_ex(const char* input, const char* output, char* encbuf, char* decbuf, int flag, int threads, size_t bufsize) {
+	try_parallel(encode);
+	try_pipeline(encode);
+	return base16384_encode_file_ex(input, output, encbuf, decbuf, flag, bufsize);
+}
+
+base16384_err_t base16384_decode_file_parallel_ex(const char* input, const char* output, char* encbuf, char* decbuf, int flag, int threads, size_t bufsize) {
+	try_parallel(decode);
+	try_pipeline(decode);
+	return base16384_decode_file_ex(input, output, encbuf, decbuf, flag, bufsize);
+}
+
+base16384_err_t base16384_encode_stream_parallel_ex(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, int threads, int depth, size_t bufsize) {
+	if(!input || !input->f.reader) {
+		return base16384_err_fopen_input_file;
+	}
+	if(!output || !output->f.writer) {
+		return base16384_err_fopen_output_file;
+	}
+	try_stream_pipeline(encode);
+	return base16384_encode_stream_ex(input, output, encbuf, decbuf, flag, bufsize);
+}
+
+base16384_err_t base16384_decode_stream_parallel_ex(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, int threads, int depth, size_t bufsize) {
+	if(!input || !input->f.reader) {
+		errno = EINVAL;
+		return base16384_err_fopen_input_file;
+	}
+	if(!output || !output->f.writer) {
+		errno = EINVAL;
+		return base16384_err_fopen_output_file;
+	}
+	try_stream_pipeline(decode);
+	return base16384_decode_stream_ex(input, output, encbuf, decbuf, flag, bufsize);
+}
+
+base16384_err_t base16384_encode_file_parallel(const char* input, const char* output, char* encbuf, char* decbuf, int flag, int threads) {
+	return base16384_encode_file_parallel_ex(input, output, encbuf, decbuf, flag, threads, BASE16384_BUFSZ);
+}
+
+base16384_err_t base16384_decode_file_parallel(const char* input, const char* output, char* encbuf, char* decbuf, int flag, int threads) {
+	return base16384_decode_file_parallel_ex(input, output, encbuf, decbuf, flag, threads, BASE16384_BUFSZ);
+}
+
+base16384_err_t base16384_encode_stream_parallel(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, int threads, int depth) {
+	return base16384_encode_stream_parallel_ex(input, output, encbuf, decbuf, flag, threads, depth, BASE16384_BUFSZ);
+}
+
+base16384_err_t base16384_decode_stream_parallel(base16384_stream_t* input, base16384_stream_t* output, char* encbuf, char* decbuf, int flag, int threads, int depth) {
+	return base16384_decode_stream_parallel_ex(input, output, encbuf, decbuf, flag, threads, depth, BASE16384_BUFSZ);
+}
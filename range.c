@@ -0,0 +1,88 @@
+/* range.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <errno.h>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+#endif
+#include "base16384.h"
+#include "binary.h"
+
+/*
+ * Byte k of the data always comes from the group at (k/7)*8 after the
+ * header, so a range is decoded from the groups covering it alone, and
+ * only the end of the file is looked at to find the `=` remainder.
+*/
+
+#define RANGE_GROUPS (512)	// groups read at a time, 4 KiB of code and 3.5 KiB of data
+
+// the code units of the underfilled group of r bytes
+static const int remain_units[7] = {0, 1, 2, 2, 3, 3, 4};
+
+ssize_t base16384_decode_range(int fd, off_t offset, size_t len, char* buf, int flag) {
+	struct stat st;
+	char in[RANGE_GROUPS*8+10], out[RANGE_GROUPS*7+8];	// full groups read with the remainder at most
+	if(fd < 0 || offset < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if(fstat(fd, &st)) return -1;
+	if(st.st_size < 2) return 0;
+	if(pread_full(fd, in, 2, 0)) return -1;
+	off_t h = (in[0] == (char)0xFE && in[1] == (char)0xFF)?2:0;
+	size_t coded = (size_t)(st.st_size - h);
+	if(has_trailer(flag)) coded = (coded > BASE16384_CRC32C_TRAILER_LEN)?coded-BASE16384_CRC32C_TRAILER_LEN:0;
+	// the full groups and the underfilled one with its `=` remainder
+	size_t ngroups = coded/8, tail = 0;
+	int r = 0;
+	if(coded >= 2) {
+		if(pread_full(fd, in, 2, h + (off_t)(coded-2))) return -1;
+		if(in[0] == '=' && in[1] >= 1 && in[1] <= 6 && coded >= (size_t)(remain_units[(int)in[1]]*2+2)) {
+			r = in[1];
+			tail = remain_units[r]*2 + 2;
+			ngroups = (coded - tail)/8;
+		}
+	}
+	size_t total = ngroups*7 + r;
+	if((size_t)offset >= total) return 0;
+	if(len > total - (size_t)offset) len = total - (size_t)offset;
+	size_t g = (size_t)offset/7, skip = (size_t)offset%7, done = 0;
+	while(done < len) {
+		size_t n = ngroups - g, m;
+		if(n > RANGE_GROUPS) n = RANGE_GROUPS;
+		size_t inlen = n*8;
+		if(g+n == ngroups && tail && (len - done) + skip > n*7) inlen += tail;	// the range hits the remainder
+		else if(!n) break;
+		if(pread_full(fd, in, inlen, h + (off_t)(g*8))) return -1;
+		m = (size_t)base16384_decode_safe(in, (int)inlen, out) - skip;
+		if(m > len - done) m = len - done;
+		memcpy(buf+done, out+skip, m);
+		done += m;
+		g += n;
+		skip = 0;
+	}
+	return (ssize_t)done;
+}
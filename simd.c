@@ -0,0 +1,585 @@
+/* simd.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _MSC_VER
+#ifndef _CRT_SECURE_NO_WARNINGS
+	#define _CRT_SECURE_NO_WARNINGS
+#endif
+#endif
+
+#ifndef __cosmopolitan
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#endif
+#include "base16384.h"
+#include "simd.h"
+
+#ifdef BASE16384_SIMD
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+/*
+ * Each 7-byte group b0..b6 is split into two 32-bit lanes
+ *   X = b0b1b2b3 -> (X>>2)&0x3fff0000 | (X>>4)&0x3fff
+ *   Y = b3b4b5b6 -> (Y<<2)&0x3fff0000 | (Y   )&0x3fff
+ * so shifting Y lanes left by 4 first lets both use the same right shifts,
+ * then 0x4e004e00 is added and each lane is written as big endian.
+*/
+
+BASE16384_TARGET("sse4.1")
+size_t _base16384_encode_sse41(const char* data, size_t n, char* buf) {
+	const __m128i gather = _mm_setr_epi8(3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10);
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i shift = _mm_setr_epi32(1, 16, 1, 16);
+	const __m128i himask = _mm_set1_epi32(0x3fff0000);
+	const __m128i lomask = _mm_set1_epi32(0x00003fff);
+	const __m128i offset = _mm_set1_epi32(0x4e004e00);
+	size_t i = 0;
+	for(; i + 3 <= n; i += 2) { // 16 bytes read for 14 bytes used
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i*7));
+		v = _mm_shuffle_epi8(v, gather);
+		v = _mm_mullo_epi32(v, shift);
+		v = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(v, 2), himask),
+			_mm_and_si128(_mm_srli_epi32(v, 4), lomask)
+		);
+		v = _mm_add_epi32(v, offset);
+		_mm_storeu_si128((__m128i*)(buf + i*8), _mm_shuffle_epi8(v, bswap));
+	}
+	return i;
+}
+
+BASE16384_TARGET("avx2")
+size_t _base16384_encode_avx2(const char* data, size_t n, char* buf) {
+	const __m256i gather = _mm256_setr_epi8(
+		3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10,
+		3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10
+	);
+	const __m256i bswap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	);
+	const __m256i shift = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+	const __m256i himask = _mm256_set1_epi32(0x3fff0000);
+	const __m256i lomask = _mm256_set1_epi32(0x00003fff);
+	const __m256i offset = _mm256_set1_epi32(0x4e004e00);
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) { // each lane reads 16 bytes for 14 bytes used
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data + i*7))),
+			_mm_loadu_si128((const __m128i*)(data + i*7 + 14)), 1
+		);
+		v = _mm256_shuffle_epi8(v, gather);
+		v = _mm256_sllv_epi32(v, shift);
+		v = _mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi32(v, 2), himask),
+			_mm256_and_si256(_mm256_srli_epi32(v, 4), lomask)
+		);
+		v = _mm256_add_epi32(v, offset);
+		_mm256_storeu_si256((__m256i*)(buf + i*8), _mm256_shuffle_epi8(v, bswap));
+	}
+	return i + _base16384_encode_sse41(data + i*7, n - i, buf + i*8);
+}
+
+/*
+ * Each 8-byte group is loaded as one big endian 64-bit lane, 0x4e00 is
+ * subtracted from every field like the scalar code does, and madd packs
+ * the fields into P = v0<<14|v1 and Q = v2<<14|v3, then P<<28|Q gives the
+ * 7 bytes of the group.
+*/
+
+/*
+ * After subtracting 0x4e00, the lowest code unit out of U+4E00..U+8DFF in
+ * a group always leaves bit 14 or 15 of its field set, while valid groups
+ * never do. So strict kernels only or the fields together and test them
+ * once at the end. On failure they report nothing decoded and let the
+ * caller find the exact position, which is not on the hot path.
+*/
+
+BASE16384_TARGET("sse4.1")
+static inline size_t decode_sse41(const char* data, size_t n, char* buf, int strict) {
+	const __m128i bswap = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	const __m128i scatter = _mm_setr_epi8(6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1);
+	const __m128i offset = _mm_set1_epi64x(0x4e004e004e004e00);
+	const __m128i fieldmask = _mm_set1_epi16(0x3fff);
+	const __m128i merge = _mm_set1_epi32(0x40000001);
+	const __m128i himask = _mm_set1_epi64x(0xfffffffff0000000);
+	const __m128i lomask = _mm_set1_epi64x(0x000000000fffffff);
+	const __m128i unitbad = _mm_set1_epi16((short)0xc000);
+	__m128i bad = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 3 <= n; i += 2) { // 16 bytes written for 14 bytes used
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i*8));
+		v = _mm_shuffle_epi8(v, bswap);
+		v = _mm_sub_epi64(v, offset);
+		if(strict) bad = _mm_or_si128(bad, v);
+		v = _mm_madd_epi16(_mm_and_si128(v, fieldmask), merge);
+		v = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi64(v, 4), himask),
+			_mm_and_si128(v, lomask)
+		);
+		_mm_storeu_si128((__m128i*)(buf + i*7), _mm_shuffle_epi8(v, scatter));
+	}
+	if(strict && !_mm_testz_si128(bad, unitbad)) return 0;
+	return i;
+}
+
+BASE16384_TARGET("sse4.1")
+size_t _base16384_decode_sse41(const char* data, size_t n, char* buf) {
+	return decode_sse41(data, n, buf, 0);
+}
+
+BASE16384_TARGET("sse4.1")
+size_t _base16384_decode_strict_sse41(const char* data, size_t n, char* buf) {
+	return decode_sse41(data, n, buf, 1);
+}
+
+BASE16384_TARGET("avx2")
+static inline size_t decode_avx2(const char* data, size_t n, char* buf, int strict) {
+	const __m256i bswap = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+	);
+	const __m256i scatter = _mm256_setr_epi8(
+		6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1,
+		6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1
+	);
+	const __m256i offset = _mm256_set1_epi64x(0x4e004e004e004e00);
+	const __m256i fieldmask = _mm256_set1_epi16(0x3fff);
+	const __m256i merge = _mm256_set1_epi32(0x40000001);
+	const __m256i himask = _mm256_set1_epi64x(0xfffffffff0000000);
+	const __m256i lomask = _mm256_set1_epi64x(0x000000000fffffff);
+	const __m256i unitbad = _mm256_set1_epi16((short)0xc000);
+	__m256i bad = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) { // each lane writes 16 bytes for 14 bytes used
+		__m256i v = _mm256_loadu_si256((const __m256i*)(data + i*8));
+		v = _mm256_shuffle_epi8(v, bswap);
+		v = _mm256_sub_epi64(v, offset);
+		if(strict) bad = _mm256_or_si256(bad, v);
+		v = _mm256_madd_epi16(_mm256_and_si256(v, fieldmask), merge);
+		v = _mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi64(v, 4), himask),
+			_mm256_and_si256(v, lomask)
+		);
+		v = _mm256_shuffle_epi8(v, scatter);
+		_mm_storeu_si128((__m128i*)(buf + i*7), _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i*)(buf + i*7 + 14), _mm256_extracti128_si256(v, 1));
+	}
+	if(strict && !_mm256_testz_si256(bad, unitbad)) return 0;
+	return i + decode_sse41(data + i*8, n - i, buf + i*7, strict);
+}
+
+BASE16384_TARGET("avx2")
+size_t _base16384_decode_avx2(const char* data, size_t n, char* buf) {
+	return decode_avx2(data, n, buf, 0);
+}
+
+BASE16384_TARGET("avx2")
+size_t _base16384_decode_strict_avx2(const char* data, size_t n, char* buf) {
+	return decode_avx2(data, n, buf, 1);
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _MSC_VER
+	#define bswap64(x) _byteswap_uint64(x)
+#else
+	#define bswap64(x) __builtin_bswap64(x)
+#endif
+
+/*
+ * One pdep spreads the 56 bits of a group into four 14-bit fields and one
+ * pext gathers them back, 4 groups are unrolled to keep loads and stores
+ * in flight. Each load/store touches 8 bytes for 7 bytes used.
+*/
+
+#define bmi2_encode_group(k) \
+	*(uint64_t*)(buf + (i+k)*8) = bswap64(_pdep_u64(bswap64(*(const uint64_t*)(data + (i+k)*7)) >> 8, 0x3fff3fff3fff3fff) + 0x4e004e004e004e00)
+
+BASE16384_TARGET("bmi2")
+size_t _base16384_encode_bmi2(const char* data, size_t n, char* buf) {
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) {
+		bmi2_encode_group(0);
+		bmi2_encode_group(1);
+		bmi2_encode_group(2);
+		bmi2_encode_group(3);
+	}
+	return i;
+}
+
+#define bmi2_decode_group(k) { \
+	uint64_t x = bswap64(*(const uint64_t*)(data + (i+k)*8)) - 0x4e004e004e004e00; \
+	if(strict) bad |= x; \
+	*(uint64_t*)(buf + (i+k)*7) = bswap64(_pext_u64(x, 0x3fff3fff3fff3fff) << 8); \
+}
+
+BASE16384_TARGET("bmi2")
+static inline size_t decode_bmi2(const char* data, size_t n, char* buf, int strict) {
+	uint64_t bad = 0;
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) {
+		bmi2_decode_group(0);
+		bmi2_decode_group(1);
+		bmi2_decode_group(2);
+		bmi2_decode_group(3);
+	}
+	if(strict && (bad&0xc000c000c000c000)) return 0;
+	return i;
+}
+
+BASE16384_TARGET("bmi2")
+size_t _base16384_decode_bmi2(const char* data, size_t n, char* buf) {
+	return decode_bmi2(data, n, buf, 0);
+}
+
+BASE16384_TARGET("bmi2")
+size_t _base16384_decode_strict_bmi2(const char* data, size_t n, char* buf) {
+	return decode_bmi2(data, n, buf, 1);
+}
+
+#endif
+
+#endif
+
+#ifdef BASE16384_SIMD
+
+BASE16384_TARGET("sse4.2")
+size_t _base16384_crc32c_sse42(uint32_t* crc, const char* data, size_t len) {
+	uint32_t c = ~*crc;
+	size_t i = 0;
+	#if defined(__x86_64__) || defined(_M_X64)
+		uint64_t c64 = c;
+		for(; i + 8 <= len; i += 8) {
+			uint64_t v;
+			memcpy(&v, data+i, 8);
+			c64 = _mm_crc32_u64(c64, v);
+		}
+		c = (uint32_t)c64;
+	#endif
+	for(; i + 4 <= len; i += 4) {
+		uint32_t v;
+		memcpy(&v, data+i, 4);
+		c = _mm_crc32_u32(c, v);
+	}
+	for(; i < len; i++) c = _mm_crc32_u8(c, (uint8_t)data[i]);
+	*crc = ~c;
+	return len;
+}
+
+#endif
+
+#ifdef BASE16384_SIMD
+
+/*
+ * Every code unit c is in U+4E00..U+8DFF, so its UTF-8 is always the 3 bytes
+ * E0|c>>12, 80|(c>>6)&3F, 80|c&3F. The UTF-8 kernels make the code units in
+ * 16-bit lanes like the ones above and spread them into these bytes in the
+ * same registers, so the UTF-16BE is never stored. A lane of 2 groups holds
+ * 8 code units, which take 24 bytes, written as 16 and 8.
+*/
+
+BASE16384_TARGET("sse4.1")
+static inline void encode_utf8_units_sse41(__m128i v, char* buf) {
+	// the units of a 32-bit lane are swapped, the first one is the high half
+	const __m128i lead_lo = _mm_setr_epi8(2, 3, -1, 0, 1, -1, 6, 7, -1, 4, 5, -1, 10, 11, -1, 8);
+	const __m128i last_lo = _mm_setr_epi8(-1, -1, 2, -1, -1, 0, -1, -1, 6, -1, -1, 4, -1, -1, 10, -1);
+	const __m128i lead_hi = _mm_setr_epi8(9, -1, 14, 15, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i last_hi = _mm_setr_epi8(-1, 8, -1, -1, 14, -1, -1, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i low6 = _mm_set1_epi16(0x3f);
+	// the first 2 bytes of a unit in a 16-bit lane and the last one in another
+	__m128i lead = _mm_or_si128(
+		_mm_or_si128(_mm_srli_epi16(v, 12), _mm_set1_epi16(0x80e0)),
+		_mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v, 6), low6), 8)
+	);
+	__m128i last = _mm_or_si128(_mm_and_si128(v, low6), _mm_set1_epi16(0x80));
+	_mm_storeu_si128((__m128i*)buf, _mm_or_si128(_mm_shuffle_epi8(lead, lead_lo), _mm_shuffle_epi8(last, last_lo)));
+	_mm_storel_epi64((__m128i*)(buf + 16), _mm_or_si128(_mm_shuffle_epi8(lead, lead_hi), _mm_shuffle_epi8(last, last_hi)));
+}
+
+BASE16384_TARGET("sse4.1")
+size_t _base16384_encode_utf8_sse41(const char* data, size_t n, char* buf) {
+	const __m128i gather = _mm_setr_epi8(3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10);
+	const __m128i shift = _mm_setr_epi32(1, 16, 1, 16);
+	const __m128i himask = _mm_set1_epi32(0x3fff0000);
+	const __m128i lomask = _mm_set1_epi32(0x00003fff);
+	const __m128i offset = _mm_set1_epi32(0x4e004e00);
+	size_t i = 0;
+	for(; i + 3 <= n; i += 2) { // 16 bytes read for 14 bytes used
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i*7));
+		v = _mm_shuffle_epi8(v, gather);
+		v = _mm_mullo_epi32(v, shift);
+		v = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(v, 2), himask),
+			_mm_and_si128(_mm_srli_epi32(v, 4), lomask)
+		);
+		encode_utf8_units_sse41(_mm_add_epi32(v, offset), buf + i*12);
+	}
+	return i;
+}
+
+BASE16384_TARGET("avx2")
+size_t _base16384_encode_utf8_avx2(const char* data, size_t n, char* buf) {
+	const __m256i gather = _mm256_setr_epi8(
+		3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10,
+		3, 2, 1, 0, 6, 5, 4, 3, 10, 9, 8, 7, 13, 12, 11, 10
+	);
+	const __m256i shift = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+	const __m256i himask = _mm256_set1_epi32(0x3fff0000);
+	const __m256i lomask = _mm256_set1_epi32(0x00003fff);
+	const __m256i offset = _mm256_set1_epi32(0x4e004e00);
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) { // each lane reads 16 bytes for 14 bytes used
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data + i*7))),
+			_mm_loadu_si128((const __m128i*)(data + i*7 + 14)), 1
+		);
+		v = _mm256_shuffle_epi8(v, gather);
+		v = _mm256_sllv_epi32(v, shift);
+		v = _mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi32(v, 2), himask),
+			_mm256_and_si256(_mm256_srli_epi32(v, 4), lomask)
+		);
+		v = _mm256_add_epi32(v, offset);
+		encode_utf8_units_sse41(_mm256_castsi256_si128(v), buf + i*12);
+		encode_utf8_units_sse41(_mm256_extracti128_si256(v, 1), buf + i*12 + 24);
+	}
+	return i + _base16384_encode_utf8_sse41(data + i*7, n - i, buf + i*12);
+}
+
+/*
+ * Decoding gathers the 3 bytes of every code unit from the 24 bytes of 2
+ * groups, loaded as bytes 0..15 and 8..23, straight into the order that
+ * the big endian 64-bit lanes of the decode kernels have, then goes on
+ * like them. As base16384_decode_safe, the lead bytes are not checked.
+*/
+
+BASE16384_TARGET("sse4.1")
+static inline __m128i decode_utf8_units_sse41(const char* data) {
+	// the last 2 bytes of a unit into a 16-bit lane, from the first and the second load
+	const __m128i tail_lo = _mm_setr_epi8(11, 10, 8, 7, 5, 4, 2, 1, -1, -1, -1, -1, -1, -1, 14, 13);
+	const __m128i tail_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 15, 14, 12, 11, 9, 8, -1, -1);
+	// the lead byte of a unit into a 16-bit lane
+	const __m128i lead_lo = _mm_setr_epi8(9, -1, 6, -1, 3, -1, 0, -1, -1, -1, -1, -1, -1, -1, 12, -1);
+	const __m128i lead_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 13, -1, 10, -1, 7, -1, -1, -1);
+	__m128i lo = _mm_loadu_si128((const __m128i*)data);
+	__m128i hi = _mm_loadu_si128((const __m128i*)(data + 8));
+	__m128i tail = _mm_or_si128(_mm_shuffle_epi8(lo, tail_lo), _mm_shuffle_epi8(hi, tail_hi));
+	__m128i lead = _mm_or_si128(_mm_shuffle_epi8(lo, lead_lo), _mm_shuffle_epi8(hi, lead_hi));
+	return _mm_or_si128(
+		_mm_slli_epi16(lead, 12),
+		_mm_or_si128(
+			_mm_and_si128(_mm_srli_epi16(tail, 2), _mm_set1_epi16(0x0fc0)),
+			_mm_and_si128(tail, _mm_set1_epi16(0x3f))
+		)
+	);
+}
+
+BASE16384_TARGET("sse4.1")
+size_t _base16384_decode_utf8_sse41(const char* data, size_t n, char* buf) {
+	const __m128i scatter = _mm_setr_epi8(6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1);
+	const __m128i offset = _mm_set1_epi64x(0x4e004e004e004e00);
+	const __m128i fieldmask = _mm_set1_epi16(0x3fff);
+	const __m128i merge = _mm_set1_epi32(0x40000001);
+	const __m128i himask = _mm_set1_epi64x(0xfffffffff0000000);
+	const __m128i lomask = _mm_set1_epi64x(0x000000000fffffff);
+	size_t i = 0;
+	for(; i + 3 <= n; i += 2) { // 16 bytes written for 14 bytes used
+		__m128i v = _mm_sub_epi64(decode_utf8_units_sse41(data + i*12), offset);
+		v = _mm_madd_epi16(_mm_and_si128(v, fieldmask), merge);
+		v = _mm_or_si128(
+			_mm_and_si128(_mm_srli_epi64(v, 4), himask),
+			_mm_and_si128(v, lomask)
+		);
+		_mm_storeu_si128((__m128i*)(buf + i*7), _mm_shuffle_epi8(v, scatter));
+	}
+	return i;
+}
+
+BASE16384_TARGET("avx2")
+size_t _base16384_decode_utf8_avx2(const char* data, size_t n, char* buf) {
+	const __m256i scatter = _mm256_setr_epi8(
+		6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1,
+		6, 5, 4, 3, 2, 1, 0, 14, 13, 12, 11, 10, 9, 8, -1, -1
+	);
+	const __m256i offset = _mm256_set1_epi64x(0x4e004e004e004e00);
+	const __m256i fieldmask = _mm256_set1_epi16(0x3fff);
+	const __m256i merge = _mm256_set1_epi32(0x40000001);
+	const __m256i himask = _mm256_set1_epi64x(0xfffffffff0000000);
+	const __m256i lomask = _mm256_set1_epi64x(0x000000000fffffff);
+	size_t i = 0;
+	for(; i + 5 <= n; i += 4) { // each lane writes 16 bytes for 14 bytes used
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(decode_utf8_units_sse41(data + i*12)),
+			decode_utf8_units_sse41(data + i*12 + 24), 1
+		);
+		v = _mm256_sub_epi64(v, offset);
+		v = _mm256_madd_epi16(_mm256_and_si256(v, fieldmask), merge);
+		v = _mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi64(v, 4), himask),
+			_mm256_and_si256(v, lomask)
+		);
+		v = _mm256_shuffle_epi8(v, scatter);
+		_mm_storeu_si128((__m128i*)(buf + i*7), _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i*)(buf + i*7 + 14), _mm256_extracti128_si256(v, 1));
+	}
+	return i + _base16384_decode_utf8_sse41(data + i*12, n - i, buf + i*7);
+}
+
+#endif
+
+#define BASE16384_CPU_SSE41	(1<<0)
+#define BASE16384_CPU_AVX2	(1<<1)
+#define BASE16384_CPU_BMI2	(1<<2)
+#define BASE16384_CPU_SSE42	(1<<3)
+
+static int detect_cpu_features() {
+	int features = 0;
+	#ifdef BASE16384_SIMD
+		#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			int maxleaf = info[0];
+			__cpuid(info, 1);
+			if((info[2]>>19)&1) features |= BASE16384_CPU_SSE41;
+			if((info[2]>>20)&1) features |= BASE16384_CPU_SSE42;
+			// osxsave & avx & the os saves ymm registers
+			int avx = ((info[2]>>27)&1) && ((info[2]>>28)&1) && ((_xgetbv(0)&6) == 6);
+			if(avx && maxleaf >= 7) {
+				__cpuidex(info, 7, 0);
+				if((info[1]>>5)&1) features |= BASE16384_CPU_AVX2;
+			}
+			if(maxleaf >= 7) {
+				__cpuidex(info, 7, 0);
+				if((info[1]>>8)&1) features |= BASE16384_CPU_BMI2;
+			}
+		#else
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("sse4.1")) features |= BASE16384_CPU_SSE41;
+			if(__builtin_cpu_supports("sse4.2")) features |= BASE16384_CPU_SSE42;
+			if(__builtin_cpu_supports("avx2")) features |= BASE16384_CPU_AVX2;
+			if(__builtin_cpu_supports("bmi2")) features |= BASE16384_CPU_BMI2;
+		#endif
+	#endif
+	return features;
+}
+
+typedef size_t (*base16384_kernel_t)(const char* data, size_t n, char* buf);
+
+struct base16384_impl_t {
+	const char* name;
+	int features;	// required BASE16384_CPU_xxx
+	base16384_kernel_t encode;
+	base16384_kernel_t decode;
+	base16384_kernel_t decode_strict;
+	base16384_kernel_t encode_utf8;
+	base16384_kernel_t decode_utf8;
+};
+typedef struct base16384_impl_t base16384_impl_t;
+
+// the fastest comes first
+static const base16384_impl_t impls[] = {
+	#ifdef BASE16384_SIMD
+		{"avx2", BASE16384_CPU_AVX2, _base16384_encode_avx2, _base16384_decode_avx2, _base16384_decode_strict_avx2, _base16384_encode_utf8_avx2, _base16384_decode_utf8_avx2},
+		{"sse4.1", BASE16384_CPU_SSE41, _base16384_encode_sse41, _base16384_decode_sse41, _base16384_decode_strict_sse41, _base16384_encode_utf8_sse41, _base16384_decode_utf8_sse41},
+		#if defined(__x86_64__) || defined(_M_X64)
+			{"bmi2", BASE16384_CPU_BMI2, _base16384_encode_bmi2, _base16384_decode_bmi2, _base16384_decode_strict_bmi2, NULL, NULL},
+		#endif
+	#endif
+	{"generic", 0, NULL, NULL, NULL, NULL, NULL},
+};
+
+static const base16384_impl_t* impl = NULL;
+
+static int cpu_features() {
+	static int features = -1;
+	if(features < 0) features = detect_cpu_features();
+	return features;
+}
+
+// find the named or else the fastest impl supported by this cpu
+static const base16384_impl_t* find_impl(const char* name) {
+	int features = cpu_features();
+	size_t i;
+	for(i = 0; i < sizeof(impls)/sizeof(impls[0]); i++) {
+		if(name && strcmp(name, impls[i].name)) continue;
+		if((impls[i].features&features) == impls[i].features) return &impls[i];
+	}
+	return NULL;
+}
+
+static inline const base16384_impl_t* get_impl() {
+	if(!impl) { // racing writers store the same value
+		const char* name = getenv("BASE16384_FORCE_IMPL");
+		const base16384_impl_t* p = (name && *name)?find_impl(name):NULL;
+		impl = p?p:find_impl(NULL);
+	}
+	return impl;
+}
+
+const char* base16384_get_impl() {
+	return get_impl()->name;
+}
+
+int base16384_set_impl(const char* name) {
+	const base16384_impl_t* p = find_impl(name);
+	if(!p) {
+		errno = EINVAL;
+		return -1;
+	}
+	impl = p;
+	return 0;
+}
+
+size_t _base16384_encode_simd(const char* data, size_t n, char* buf) {
+	base16384_kernel_t encode = get_impl()->encode;
+	return encode?encode(data, n, buf):0;
+}
+
+size_t _base16384_decode_simd(const char* data, size_t n, char* buf) {
+	base16384_kernel_t decode = get_impl()->decode;
+	return decode?decode(data, n, buf):0;
+}
+
+size_t _base16384_decode_strict_simd(const char* data, size_t n, char* buf) {
+	base16384_kernel_t decode_strict = get_impl()->decode_strict;
+	return decode_strict?decode_strict(data, n, buf):0;
+}
+
+size_t _base16384_encode_utf8_simd(const char* data, size_t n, char* buf) {
+	base16384_kernel_t encode_utf8 = get_impl()->encode_utf8;
+	return encode_utf8?encode_utf8(data, n, buf):0;
+}
+
+size_t _base16384_decode_utf8_simd(const char* data, size_t n, char* buf) {
+	base16384_kernel_t decode_utf8 = get_impl()->decode_utf8;
+	return decode_utf8?decode_utf8(data, n, buf):0;
+}
+
+size_t _base16384_crc32c_simd(uint32_t* crc, const char* data, size_t len) {
+	#ifdef BASE16384_SIMD
+		// the generic kernel means no SIMD at all, so that the tables get tested too
+		if(get_impl()->features && (cpu_features()&BASE16384_CPU_SSE42)) return _base16384_crc32c_sse42(crc, data, len);
+	#endif
+	return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+/* simd.h
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#if !defined(__cosmopolitan) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+	#define BASE16384_SIMD
+#endif
+
+/**
+ * @brief encode full 7-byte groups with the kernel selected by base16384_set_impl
+ * @param data data to encode, no data overread beyond `n*7` bytes
+ * @param n the count of full groups in data
+ * @param buf the output buffer, no data overwrite beyond `n*8` bytes
+ * @return the count of groups encoded, the caller must handle the rest
+*/
+size_t _base16384_encode_simd(const char* data, size_t n, char* buf);
+
+/**
+ * @brief decode full 8-byte groups with the kernel selected by base16384_set_impl
+ * @param data data to decode, no data overread beyond `n*8` bytes
+ * @param n the count of full groups in data
+ * @param buf the output buffer, no data overwrite beyond `n*7` bytes
+ * @return the count of groups decoded, the caller must handle the rest
+*/
+size_t _base16384_decode_simd(const char* data, size_t n, char* buf);
+
+/**
+ * @brief like `_base16384_decode_simd` but stop before the first block that has
+ *        code units out of U+4E00..U+8DFF
+ * @param data data to decode, no data overread beyond `n*8` bytes
+ * @param n the count of full groups in data
+ * @param buf the output buffer, no data overwrite beyond `n*7` bytes
+ * @return the count of valid groups decoded, the caller must check the rest
+*/
+size_t _base16384_decode_strict_simd(const char* data, size_t n, char* buf);
+
+/**
+ * @brief encode full 7-byte groups into UTF-8 with the kernel selected by base16384_set_impl
+ * @param data data to encode, no data overread beyond `n*7` bytes
+ * @param n the count of full groups in data
+ * @param buf the output buffer, no data overwrite beyond `n*12` bytes
+ * @return the count of groups encoded, the caller must handle the rest
+*/
+size_t _base16384_encode_utf8_simd(const char* data, size_t n, char* buf);
+
+/**
+ * @brief decode the UTF-8 of full groups with the kernel selected by base16384_set_impl
+ * @param data data to decode, no data overread beyond `n*12` bytes
+ * @param n the count of full groups in data
+ * @param buf the output buffer, no data overwrite beyond `n*7` bytes
+ * @return the count of groups decoded, the caller must handle the rest
+*/
+size_t _base16384_decode_utf8_simd(const char* data, size_t n, char* buf);
+
+/**
+ * @brief update a CRC32C with the crc32 instructions of SSE4.2
+ * @param crc the CRC32C to update
+ * @param data the data to add
+ * @param len the data length
+ * @return the count of bytes added, 0 if unsupported and the caller must use tables
+*/
+size_t _base16384_crc32c_simd(uint32_t* crc, const char* data, size_t len);
+
+#ifdef BASE16384_SIMD
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define BASE16384_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define BASE16384_TARGET(isa)
+#endif
+
+size_t _base16384_encode_sse41(const char* data, size_t n, char* buf);
+size_t _base16384_encode_avx2(const char* data, size_t n, char* buf);
+size_t _base16384_decode_sse41(const char* data, size_t n, char* buf);
+size_t _base16384_decode_avx2(const char* data, size_t n, char* buf);
+size_t _base16384_decode_strict_sse41(const char* data, size_t n, char* buf);
+size_t _base16384_decode_strict_avx2(const char* data, size_t n, char* buf);
+size_t _base16384_crc32c_sse42(uint32_t* crc, const char* data, size_t len);
+size_t _base16384_encode_utf8_sse41(const char* data, size_t n, char* buf);
+size_t _base16384_encode_utf8_avx2(const char* data, size_t n, char* buf);
+size_t _base16384_decode_utf8_sse41(const char* data, size_t n, char* buf);
+size_t _base16384_decode_utf8_avx2(const char* data, size_t n, char* buf);
+#if defined(__x86_64__) || defined(_M_X64)
+	size_t _base16384_encode_bmi2(const char* data, size_t n, char* buf);
+	size_t _base16384_decode_bmi2(const char* data, size_t n, char* buf);
+	size_t _base16384_decode_strict_bmi2(const char* data, size_t n, char* buf);
+#endif
+
+#endif
+
+#endif
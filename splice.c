@@ -0,0 +1,152 @@
+/* splice.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE	// vmsplice, F_SETPIPE_SZ
+#endif
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+#include "splice.h"
+
+#ifdef BASE16384_SPLICE
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ) && defined(SPLICE_F_GIFT)
+
+int _base16384_is_pipe(int fd) {
+	struct stat st;
+	return !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+}
+
+static int vmsplice_full(int fd, char* buf, size_t len) {
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	while(iov.iov_len) {
+		ssize_t n = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return -1;
+		iov.iov_base = (char*)iov.iov_base + n;
+		iov.iov_len -= n;
+	}
+	return 0;
+}
+
+#define goto_base16384_code_fd_splice_cleanup(reason) { \
+	*err = reason; \
+	goto base16384_code_fd_splice_cleanup; \
+}
+
+/*
+ * The pipe keeps referencing the pages of a vmspliced chunk until they are
+ * read, and the reader may tee() or splice() them onward, so a gifted page
+ * must never be written again. Each chunk is coded into freshly mapped pages
+ * instead, which are unmapped right after the gift and freed by the kernel
+ * once the pipe drops them. Should no pages be mapped, the chunk is copied
+ * by write() from a spare buffer, and so is the tail.
+*/
+static int code_fd_splice(int input, int output, char* inbuf, size_t bufsize, int flag, int is_encode, base16384_err_t* err) {
+	if(!_base16384_is_pipe(output)) return -1;
+	size_t pagesz = (size_t)sysconf(_SC_PAGESIZE);
+	int readsize = read_chunk_size(bufsize, is_encode?7:8);
+	size_t chunk = is_encode?base16384_encoder_update_len(readsize):base16384_decoder_update_len(readsize);
+	if(is_encode && is_utf8(flag)) chunk = base16384_utf8_len((int)chunk);
+	chunk = (chunk+pagesz-1)/pagesz*pagesz;
+	// let one whole chunk sit in the pipe, pipe-max-size may refuse it though
+	int pipesz = fcntl(output, F_GETPIPE_SZ);
+	if(pipesz > 0 && (size_t)pipesz < chunk) {
+		int n = fcntl(output, F_SETPIPE_SZ, (int)chunk);
+		if(n > 0) pipesz = n;
+	}
+	if(pipesz <= 0) return -1;
+	char* spare = (char*)mmap(NULL, chunk, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(spare == MAP_FAILED) return -1;
+	base16384_encoder_t enc;
+	base16384_decoder_t dec;
+	if(is_encode) base16384_encoder_init(&enc, flag);
+	else base16384_decoder_init(&dec, flag);
+	*err = base16384_err_ok;
+
+	ssize_t cnt;
+	int n;
+	for(;;) {
+		while((cnt = read(input, inbuf, readsize)) < 0 && errno == EINTR);
+		if(cnt < 0) goto_base16384_code_fd_splice_cleanup(base16384_err_read_file);
+		if(!cnt) break;
+		char* out = (char*)mmap(NULL, chunk, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		int gift = out != MAP_FAILED;
+		if(!gift) out = spare;
+		n = is_encode
+			?base16384_encoder_update(&enc, inbuf, (int)cnt, out)
+			:base16384_decoder_update(&dec, inbuf, (int)cnt, out);
+		if(gift) {
+			int failed = n && vmsplice_full(output, out, n);
+			munmap(out, chunk); // the pipe holds its own references to the gifted pages
+			if(failed) goto_base16384_code_fd_splice_cleanup(base16384_err_write_file);
+		} else if(n && write_full(output, out, n)) goto_base16384_code_fd_splice_cleanup(base16384_err_write_file);
+	}
+	if(is_encode) n = base16384_encoder_final(&enc, spare);
+	else if((n = base16384_decoder_final(&dec, spare)) < 0) {
+		goto_base16384_code_fd_splice_cleanup(base16384_err_invalid_decoding_checksum);
+	}
+	if(n && write_full(output, spare, n)) *err = base16384_err_write_file;
+base16384_code_fd_splice_cleanup:;
+	int errnobak = errno;
+	munmap(spare, chunk);
+	errno = errnobak;
+	return 0;
+}
+
+#undef goto_base16384_code_fd_splice_cleanup
+
+int _base16384_encode_fd_splice(int input, int output, char* encbuf, size_t bufsize, int flag, base16384_err_t* err) {
+	return code_fd_splice(input, output, encbuf, bufsize, flag, 1, err);
+}
+
+int _base16384_decode_fd_splice(int input, int output, char* decbuf, size_t bufsize, int flag, base16384_err_t* err) {
+	return code_fd_splice(input, output, decbuf, bufsize, flag, 0, err);
+}
+
+#else
+
+int _base16384_is_pipe(int fd) {
+	return 0;
+}
+
+int _base16384_encode_fd_splice(int input, int output, char* encbuf, size_t bufsize, int flag, base16384_err_t* err) {
+	return -1;
+}
+
+int _base16384_decode_fd_splice(int input, int output, char* decbuf, size_t bufsize, int flag, base16384_err_t* err) {
+	return -1;
+}
+
+#endif
+
+#endif
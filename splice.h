@@ -0,0 +1,61 @@
+#ifndef _SPLICE_H_
+#define _SPLICE_H_
+
+/* splice.h
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__linux__) && !defined(__cosmopolitan)
+	#define BASE16384_SPLICE
+#endif
+
+#ifdef BASE16384_SPLICE
+
+/**
+ * @brief check whether fd is a pipe that encoded or decoded data can be vmspliced into
+ * @param fd file descripter
+ * @return 1 if it is a pipe, or else 0
+*/
+int _base16384_is_pipe(int fd);
+
+/**
+ * @brief encode input fd into the pipe output by vmsplicing page-aligned chunks
+ * @param input file descripter
+ * @param output file descripter of a pipe
+ * @param encbuf the buffer to read input into, no less than `base16384_encbuf_len(bufsize)`
+ * @param bufsize the bytes read at a time
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param err where to put the error code
+ * @return 0 if done or -1 if output is not a pipe and nothing is touched
+*/
+int _base16384_encode_fd_splice(int input, int output, char* encbuf, size_t bufsize, int flag, base16384_err_t* err);
+
+/**
+ * @brief decode input fd into the pipe output by vmsplicing page-aligned chunks
+ * @param input file descripter
+ * @param output file descripter of a pipe
+ * @param decbuf the buffer to read input into, no less than `base16384_decbuf_len(bufsize)`
+ * @param bufsize the bytes read at a time
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param err where to put the error code
+ * @return 0 if done or -1 if output is not a pipe and nothing is touched
+*/
+int _base16384_decode_fd_splice(int input, int output, char* decbuf, size_t bufsize, int flag, base16384_err_t* err);
+
+#endif
+
+#endif
@@ -20,15 +20,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 
 #include "base16384.h"
+#include "binary.h"
 
 #define TEST_SIZE (4096)
 
 static char encbuf[TEST_SIZE+16];
 static char decbuf[TEST_SIZE/7*8+16];
 static char tstbuf[TEST_SIZE+16];
+static char refbuf[TEST_SIZE/7*8+16];
+static char pushbuf[TEST_SIZE/7*8+16];
+static char utf8buf[(TEST_SIZE/7*8+16)/2*3];
+static char utf8ref[(TEST_SIZE/7*8+16)/2*3];
+
+#define COL_ITEMS (128)
+#define COL_BIG (8192) // longer than one gathered batch
+#define COL_SIZE (COL_ITEMS*200+COL_BIG)
+
+static char colin[COL_SIZE];
+static char colenc[COL_SIZE/7*8+COL_ITEMS*16];
+static char coldec[COL_SIZE+COL_ITEMS*16];
+static char colref[COL_BIG/7*8+16];
+static int coloff[COL_ITEMS+1], colencoff[COL_ITEMS+1], coldecoff[COL_ITEMS+1];
+static uint8_t colvalid[COL_ITEMS/8];
+static const int colwidths[] = {0, 1, 6, 7, 13, 14, 100};
+
+static const char* impls[] = {"generic", "bmi2", "sse4.1", "avx2"};
 
 #define loop_diff(target) \
     for(i = start; i < end; i++) { \
@@ -69,6 +89,456 @@ static char tstbuf[TEST_SIZE+16];
         if (memcmp(encbuf, tstbuf, n)) return_error(i, n); \
     }
 
+#define test_same_as_generic(encode, decode) \
+    fputs("comparing base16384_"#encode"/base16384_"#decode" with generic...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        base16384_set_impl("generic"); \
+        n = base16384_##encode(encbuf, i, refbuf); \
+        base16384_set_impl(impls[k]); \
+        if (base16384_##encode(encbuf, i, decbuf) != n || memcmp(refbuf, decbuf, n)) { \
+            fprintf(stderr, "encoding mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n = base16384_##decode(decbuf, n, tstbuf); \
+        if (memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+#define test_strict(encode) \
+    fputs("testing base16384_"#encode"/base16384_decode_strict...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        n = base16384_##encode(encbuf, i, decbuf); \
+        if (base16384_decode_strict(decbuf, n, tstbuf, NULL) != i) { \
+            fprintf(stderr, "strict decoding rejected valid data @ loop %d\n", i); \
+            return 1; \
+        } \
+        if (memcmp(encbuf, tstbuf, i)) return_error(i, n); \
+        int end = (i%7)?(n-2):n; \
+        if (!end) continue; \
+        int pos = rand()%(end/2)*2, errpos = -1; \
+        char unit = decbuf[pos]; \
+        decbuf[pos] = (rand()&1)?0x4d:0x8e; \
+        if (base16384_decode_strict(decbuf, n, tstbuf, &errpos) != -1 || errpos != pos) { \
+            fprintf(stderr, "strict decoding missed invalid unit @ %d of loop %d, got %d\n", pos, i, errpos); \
+            return 1; \
+        } \
+        decbuf[pos] = unit; \
+    }
+
+// the *64 variants run over several chunks in the test build
+#define test_64(encode, decode) \
+    fputs("testing base16384_"#encode"64/base16384_"#decode"64...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        n = base16384_##encode(encbuf, i, refbuf); \
+        if (_base16384_encode_len64(i) != (size_t)n || base16384_##encode##64(encbuf, i, decbuf) != (size_t)n || memcmp(refbuf, decbuf, n)) { \
+            fprintf(stderr, "64-bit encoding mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        if (!n) continue; \
+        if (_base16384_decode_len64(n, (i%7)?decbuf[n-1]:0) != (size_t)i) { \
+            fprintf(stderr, "64-bit decoding length mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n = (int)base16384_##decode##64(decbuf, n, tstbuf); \
+        if (n != i || memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+#define test_strict64() \
+    fputs("testing base16384_encode_safe64/base16384_decode_strict64...\n", stderr); \
+    for(i = 1; i <= TEST_SIZE; i++) { \
+        n = (int)base16384_encode_safe64(encbuf, i, decbuf); \
+        size_t errpos = 0; \
+        if (base16384_decode_strict64(decbuf, n, tstbuf, &errpos) != i || memcmp(encbuf, tstbuf, i)) { \
+            fprintf(stderr, "64-bit strict decoding rejected valid data @ loop %d\n", i); \
+            return 1; \
+        } \
+        int end = (i%7)?(n-2):n, pos = rand()%(end/2)*2; \
+        char unit = decbuf[pos]; \
+        decbuf[pos] = 0x8e; \
+        if (base16384_decode_strict64(decbuf, n, tstbuf, &errpos) != -1 || errpos != (size_t)pos) { \
+            fprintf(stderr, "64-bit strict decoding missed invalid unit @ %d of loop %d\n", pos, i); \
+            return 1; \
+        } \
+        decbuf[pos] = unit; \
+    } \
+    if (_base16384_encode_len64(SIZE_MAX) != SIZE_MAX || base16384_encode_len64(SIZE_MAX/8*7) != SIZE_MAX) { \
+        fputs("64-bit encoding length overflow unchecked\n", stderr); \
+        return 1; \
+    }
+
+// the byte by byte sum that calc_sum must reproduce
+static uint32_t naive_sum(uint32_t sum, int cnt, const char* data) {
+    int i;
+    for(i = 0; i < cnt; i++) {
+        uint32_t b = (uint32_t)(data[i])&0xff;
+        b = ((b<<(24-6))&0x03000000) | ((b<<(16-4))&0x00030000) | ((b<<(8-2))&0x00000300) | (b&0x03);
+        sum += b;
+        sum = ~LEFTROTATE(sum, 3);
+    }
+    return sum;
+}
+
+#define test_calc_sum() \
+    fputs("testing calc_sum...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        uint32_t init = (i&1)?BASE16384_SIMPLE_SUM_INIT_VALUE:(uint32_t)rand(); \
+        int off = rand()%8; \
+        if (i+off > TEST_SIZE) off = 0; \
+        if (calc_sum(init, i, encbuf+off) != naive_sum(init, i, encbuf+off)) { \
+            fprintf(stderr, "sum mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+    }
+
+// the bit by bit crc32c that base16384_crc32c must reproduce
+static uint32_t naive_crc32c(uint32_t crc, int cnt, const char* data) {
+    int i, j;
+    crc = ~crc;
+    for(i = 0; i < cnt; i++) {
+        crc ^= (uint32_t)(data[i])&0xff;
+        for(j = 0; j < 8; j++) crc = (crc>>1) ^ (0x82f63b78 & (0-(crc&1)));
+    }
+    return ~crc;
+}
+
+#define test_crc32c() \
+    fputs("testing base16384_crc32c...\n", stderr); \
+    if (base16384_crc32c(0, "123456789", 9) != 0xe3069283) { \
+        fputs("crc32c check value mismatch\n", stderr); \
+        return 1; \
+    } \
+    for(i = 0; i <= TEST_SIZE; i += 1+i/64) { \
+        int off = rand()%8, cut = i?rand()%i:0; \
+        if (i+off > TEST_SIZE) off = 0; \
+        uint32_t crc = base16384_crc32c(0, encbuf+off, cut); \
+        if (base16384_crc32c(crc, encbuf+off+cut, i-cut) != naive_crc32c(0, i, encbuf+off)) { \
+            fprintf(stderr, "crc32c mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+    }
+
+#define test_crc_coder(flag) \
+    fputs("testing base16384 coder with flag "#flag"...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        base16384_encoder_t enc; \
+        base16384_encoder_init(&enc, flag); \
+        int p = 0, m = 0; \
+        while(p < i) { \
+            int chunk = rand()%24; \
+            if(chunk > i-p) chunk = i-p; \
+            m += base16384_encoder_update(&enc, encbuf+p, chunk, pushbuf+m); \
+            p += chunk; \
+        } \
+        m += base16384_encoder_final(&enc, pushbuf+m); \
+        int h = ((flag)&BASE16384_FLAG_NOHEADER)?0:2; \
+        n = base16384_encode_safe(encbuf, i, refbuf); \
+        if (m != h+n+BASE16384_CRC32C_TRAILER_LEN || (!do_sum_check(flag) && memcmp(refbuf, pushbuf+h, n))) { \
+            fprintf(stderr, "crc encoder result mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        if ((flag)&BASE16384_FLAG_CRC_TREE) { \
+            uint32_t leaves[TEST_SIZE/BASE16384_CRC_TREE_BLOCK+1], root; \
+            base16384_decode_safe(pushbuf+m-BASE16384_CRC32C_TRAILER_LEN, BASE16384_CRC32C_TRAILER_LEN, (char*)&root); \
+            if (be32toh(root) != base16384_crc_tree_root(leaves, base16384_crc_tree_leaves(encbuf, i, leaves))) { \
+                fprintf(stderr, "crc tree root mismatch @ loop %d\n", i); \
+                return 1; \
+            } \
+        } \
+        int corrupt = rand()%3; /* 1 flips a data bit, 2 flips a trailer bit */ \
+        if (corrupt == 1 && i) pushbuf[h+(rand()%(i/7*8+(i%7?1:0)))] ^= 0x10; \
+        else if (corrupt == 2) pushbuf[m-5] ^= 1; /* the last unit of the trailer is partly padding */ \
+        else corrupt = 0; \
+        base16384_decoder_t dec; \
+        base16384_decoder_init(&dec, flag); \
+        p = 0; \
+        n = 0; \
+        while(p < m) { \
+            int chunk = rand()%24; \
+            if(chunk > m-p) chunk = m-p; \
+            n += base16384_decoder_update(&dec, pushbuf+p, chunk, tstbuf+n); \
+            p += chunk; \
+        } \
+        int x = base16384_decoder_final(&dec, tstbuf+n); \
+        if (corrupt) { \
+            if (x >= 0) { \
+                fprintf(stderr, "decoder missed crc32c error @ loop %d\n", i); \
+                return 1; \
+            } \
+            continue; \
+        } \
+        if (x < 0) { \
+            fprintf(stderr, "decoder crc32c mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n += x; \
+        if (n != i) return_error(i, n); \
+        if (memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+// the 3 bytes of UTF-8 of every code unit
+static int naive_utf8(const char* data, int len, char* buf) {
+    int i, n = 0;
+    for(i = 0; i < len; i += 2) {
+        int c = (uint8_t)data[i]*256 + (uint8_t)data[i+1];
+        buf[n++] = (char)(0xe0 + c/4096);
+        buf[n++] = (char)(0x80 + c/64%64);
+        buf[n++] = (char)(0x80 + c%64);
+    }
+    return n;
+}
+
+#define test_utf8() \
+    fputs("testing base16384_encode_utf8/base16384_decode_utf8...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        n = naive_utf8(refbuf, base16384_encode_safe(encbuf, i, refbuf), utf8ref); \
+        if (n != _base16384_encode_utf8_len(i) || base16384_encode_utf8(encbuf, i, utf8buf) != n || memcmp(utf8ref, utf8buf, n)) { \
+            fprintf(stderr, "utf8 encoding mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n = base16384_decode_utf8(utf8buf, n, tstbuf); \
+        if (n != i || memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+// the push coder with BASE16384_FLAG_UTF8 must write the UTF-8 of what it writes without
+#define test_utf8_coder(flag) \
+    fputs("testing base16384 coder with flag BASE16384_FLAG_UTF8|"#flag"...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        base16384_encoder_t enc; \
+        base16384_encoder_init(&enc, flag); \
+        n = base16384_encoder_update(&enc, encbuf, i, pushbuf); \
+        n = naive_utf8(pushbuf, n + base16384_encoder_final(&enc, pushbuf+n), utf8ref); \
+        base16384_encoder_init(&enc, BASE16384_FLAG_UTF8|(flag)); \
+        int p = 0, m = 0; \
+        while(p < i) { \
+            int chunk = rand()%24; \
+            if(chunk > i-p) chunk = i-p; \
+            m += base16384_encoder_update(&enc, encbuf+p, chunk, utf8buf+m); \
+            p += chunk; \
+        } \
+        m += base16384_encoder_final(&enc, utf8buf+m); \
+        if (m != n || memcmp(utf8ref, utf8buf, n)) { \
+            fprintf(stderr, "utf8 encoder result mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        base16384_decoder_t dec; \
+        base16384_decoder_init(&dec, BASE16384_FLAG_UTF8|(flag)); \
+        p = 0; \
+        n = 0; \
+        while(p < m) { \
+            int chunk = rand()%40; \
+            if(chunk > m-p) chunk = m-p; \
+            n += base16384_decoder_update(&dec, utf8buf+p, chunk, tstbuf+n); \
+            p += chunk; \
+        } \
+        int x = base16384_decoder_final(&dec, tstbuf+n); \
+        if (x < 0) { \
+            fprintf(stderr, "utf8 decoder checksum mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n += x; \
+        if (n != i || memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+// a tail without all the units of its group must be rejected instead of decoded
+#define test_decoder_malformed() \
+    fputs("testing base16384_decoder with malformed tails...\n", stderr); \
+    for(i = 1; i <= 6; i++) { \
+        char tail[] = {0x4e, 0x00, '=', (char)i}; \
+        int k; \
+        for(k = (i > 1)?0:2; k <= 2; k += 2) { /* one unit is enough only for offset 1 */ \
+            base16384_decoder_t dec; \
+            base16384_decoder_init(&dec, 0); \
+            n = base16384_decoder_update(&dec, tail+k, (int)sizeof(tail)-k, tstbuf); \
+            errno = 0; \
+            if (base16384_decoder_final(&dec, tstbuf+n) >= 0 || errno != EINVAL) { \
+                fprintf(stderr, "decoder accepted malformed tail of %d units @ offset %d\n", (2-k)/2, i); \
+                return 1; \
+            } \
+        } \
+    }
+
+#define test_encoder(flag) \
+    fputs("testing base16384_encoder with flag "#flag"...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        base16384_encoder_t enc; \
+        base16384_encoder_init(&enc, flag); \
+        int p = 0, m = 0; \
+        while(p < i) { \
+            int chunk = rand()%24; \
+            if(chunk > i-p) chunk = i-p; \
+            m += base16384_encoder_update(&enc, encbuf+p, chunk, pushbuf+m); \
+            p += chunk; \
+        } \
+        m += base16384_encoder_final(&enc, pushbuf+m); \
+        int h = ((flag)&BASE16384_FLAG_NOHEADER)?0:2; \
+        if(h && (pushbuf[0] != (char)0xFE || pushbuf[1] != (char)0xFF)) { \
+            fprintf(stderr, "encoder header mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n = base16384_encode_safe(encbuf, i, refbuf); \
+        if (m != n+h || (!do_sum_check(flag) && memcmp(refbuf, pushbuf+h, n))) { \
+            fprintf(stderr, "encoder result mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        if (!n) continue; \
+        n = base16384_decode_unsafe(pushbuf+h, n, tstbuf); \
+        if (memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+        if (do_sum_check(flag) && check_sum(calc_sum(BASE16384_SIMPLE_SUM_INIT_VALUE, i, encbuf), *(uint32_t*)(&tstbuf[i]), i)) { \
+            fprintf(stderr, "encoder checksum mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+    }
+
+#define test_decoder(flag) \
+    fputs("testing base16384_decoder with flag "#flag"...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        base16384_encoder_t enc; \
+        base16384_encoder_init(&enc, flag); \
+        int m = base16384_encoder_update(&enc, encbuf, i, pushbuf); \
+        m += base16384_encoder_final(&enc, pushbuf+m); \
+        int corrupt = do_sum_check(flag) && i%7 && rand()%2; \
+        if (corrupt) pushbuf[m-3] ^= 1; /* the lowest bit in the last unit is a sum bit */ \
+        base16384_decoder_t dec; \
+        base16384_decoder_init(&dec, flag); \
+        int p = 0; \
+        n = 0; \
+        while(p < m) { \
+            int chunk = rand()%24; \
+            if(chunk > m-p) chunk = m-p; \
+            n += base16384_decoder_update(&dec, pushbuf+p, chunk, tstbuf+n); \
+            p += chunk; \
+        } \
+        int x = base16384_decoder_final(&dec, tstbuf+n); \
+        if (corrupt) { \
+            if (x >= 0) { \
+                fprintf(stderr, "decoder missed checksum error @ loop %d\n", i); \
+                return 1; \
+            } \
+            continue; \
+        } \
+        if (x < 0) { \
+            fprintf(stderr, "decoder checksum mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        n += x; \
+        if (n != i) return_error(i, n); \
+        if (memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+    }
+
+#define col_valid(j) ((colvalid[(j)>>3]>>((j)&7))&1)
+
+// corrupt a random code unit of the item at p of len bytes, returning if there was one
+static int col_corrupt(char* p, int len) {
+    int units = (len%8)?(len-2):len;
+    if (units) p[rand()%(units/2)*2] = 0x4d;
+    return units > 0;
+}
+
+#define test_columnar() \
+    fputs("testing base16384_encode_batch/base16384_decode_batch...\n", stderr); \
+    for(i = 0; i < 64; i++) { \
+        int j, bad = -1; \
+        coloff[0] = 0; \
+        for(j = 0; j < COL_ITEMS; j++) coloff[j+1] = coloff[j] + ((j == i)?COL_BIG:rand()%201); \
+        for(j = 0; j < coloff[COL_ITEMS]; j++) colin[j] = rand(); \
+        n = base16384_encode_batch(colin, coloff, COL_ITEMS, colenc, colencoff); \
+        if (n != base16384_encode_batch_len(coloff, COL_ITEMS) || n != colencoff[COL_ITEMS]) { \
+            fprintf(stderr, "batch encoding length mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        for(j = 0; j < COL_ITEMS; j++) { \
+            int m = base16384_encode_safe(colin+coloff[j], coloff[j+1]-coloff[j], colref); \
+            if (m != colencoff[j+1]-colencoff[j] || memcmp(colref, colenc+colencoff[j], m)) { \
+                fprintf(stderr, "batch encoding mismatch @ item %d of loop %d\n", j, i); \
+                return 1; \
+            } \
+        } \
+        j = rand()%COL_ITEMS; \
+        if (col_corrupt(colenc+colencoff[j], colencoff[j+1]-colencoff[j])) bad = j; \
+        int max = base16384_decode_batch_len(colenc, colencoff, COL_ITEMS); \
+        n = base16384_decode_batch(colenc, colencoff, COL_ITEMS, coldec, coldecoff, colvalid); \
+        if (n != COL_ITEMS-(bad >= 0) || coldecoff[COL_ITEMS] > max) { \
+            fprintf(stderr, "batch decoding got %d valid items @ loop %d\n", n, i); \
+            return 1; \
+        } \
+        for(j = 0; j < COL_ITEMS; j++) { \
+            int m = (j == bad)?0:(coloff[j+1]-coloff[j]); \
+            if (col_valid(j) != (j != bad) || coldecoff[j+1]-coldecoff[j] != m || memcmp(colin+coloff[j], coldec+coldecoff[j], m)) { \
+                fprintf(stderr, "batch decoding mismatch @ item %d of loop %d\n", j, i); \
+                return 1; \
+            } \
+        } \
+    } \
+    fputs("testing base16384_encode_batch_fixed/base16384_decode_batch_fixed...\n", stderr); \
+    for(i = 0; i < (int)(sizeof(colwidths)/sizeof(colwidths[0])); i++) { \
+        int j, w = colwidths[i], stride = _base16384_encode_len(w), bad = -1; \
+        for(j = 0; j < w*COL_ITEMS; j++) colin[j] = rand(); \
+        n = base16384_encode_batch_fixed(colin, w, COL_ITEMS, colenc); \
+        if (n != stride*COL_ITEMS) { \
+            fprintf(stderr, "fixed batch encoding length mismatch @ width %d\n", w); \
+            return 1; \
+        } \
+        for(j = 0; j < COL_ITEMS; j++) { \
+            base16384_encode_safe(colin+j*w, w, colref); \
+            if (memcmp(colref, colenc+j*stride, stride)) { \
+                fprintf(stderr, "fixed batch encoding mismatch @ item %d of width %d\n", j, w); \
+                return 1; \
+            } \
+        } \
+        j = rand()%COL_ITEMS; \
+        if (col_corrupt(colenc+j*stride, stride)) bad = j; \
+        n = base16384_decode_batch_fixed(colenc, w, COL_ITEMS, coldec, colvalid); \
+        if (n != COL_ITEMS-(bad >= 0)) { \
+            fprintf(stderr, "fixed batch decoding got %d valid items @ width %d\n", n, w); \
+            return 1; \
+        } \
+        memset(colref, 0, w); \
+        for(j = 0; j < COL_ITEMS; j++) { \
+            if (col_valid(j) != (j != bad) || memcmp((j == bad)?colref:(colin+j*w), coldec+j*w, w)) { \
+                fprintf(stderr, "fixed batch decoding mismatch @ item %d of width %d\n", j, w); \
+                return 1; \
+            } \
+        } \
+    }
+
+#ifndef _WIN32
+// the fragments must give the same output as their concatenation
+#define test_iov() \
+    fputs("testing base16384_encode_iov/base16384_decode_iov...\n", stderr); \
+    for(i = 0; i <= TEST_SIZE; i++) { \
+        struct iovec iov[8]; \
+        int cnt, p, m, txtlen; \
+        for(cnt = 0, p = 0; cnt < 8 && p < i; cnt++, p += m) { \
+            m = (cnt == 7)?(i-p):(rand()%(i-p+1)); \
+            iov[cnt].iov_base = encbuf+p; \
+            iov[cnt].iov_len = m; \
+        } \
+        n = base16384_encode_safe(encbuf, i, refbuf); \
+        if (base16384_encode_iov_len(iov, cnt) != n || base16384_encode_iov(iov, cnt, decbuf) != n || memcmp(refbuf, decbuf, n)) { \
+            fprintf(stderr, "iov encoding mismatch @ loop %d\n", i); \
+            return 1; \
+        } \
+        for(cnt = 0, p = 0; cnt < 8 && p < n; cnt++, p += m) { \
+            m = (cnt == 7)?(n-p):(rand()%(n-p+1)); \
+            iov[cnt].iov_base = decbuf+p; \
+            iov[cnt].iov_len = m; \
+        } \
+        if (base16384_decode_iov_len(iov, cnt) < i) { \
+            fprintf(stderr, "iov decoding length too short @ loop %d\n", i); \
+            return 1; \
+        } \
+        txtlen = n; \
+        n = base16384_decode_iov(iov, cnt, tstbuf); \
+        if (n != i || memcmp(encbuf, tstbuf, n)) return_error(i, n); \
+        if (i%7) { \
+            decbuf[txtlen-1] = 7; /* no remainder has an offset of 7 */ \
+            if ((n = base16384_decode_iov(iov, cnt, tstbuf)) != -1) { \
+                fprintf(stderr, "iov decoding returned %d on a bad tail @ loop %d\n", n, i); \
+                return 1; \
+            } \
+        } \
+    }
+#endif
+
 int main() {
     srand(time(NULL));
     int i, n;
@@ -76,16 +546,71 @@ int main() {
         *(int*)(&encbuf[i]) = rand();
     }
 
-    test_batch(encode, decode);
-    test_batch(encode, decode_unsafe);
-    test_batch(encode, decode_safe);
+    int k;
+    for(k = 0; k < (int)(sizeof(impls)/sizeof(impls[0])); k++) {
+        if(base16384_set_impl(impls[k])) {
+            fprintf(stderr, "skip unsupported impl %s\n", impls[k]);
+            continue;
+        }
+        fprintf(stderr, "using impl %s\n", base16384_get_impl());
+
+        test_batch(encode, decode);
+        test_batch(encode, decode_unsafe);
+        test_batch(encode, decode_safe);
+
+        test_batch(encode_unsafe, decode);
+        test_batch(encode_unsafe, decode_unsafe);
+        test_batch(encode_unsafe, decode_safe);
+
+        test_batch(encode_safe, decode);
+        test_batch(encode_safe, decode_unsafe);
+        test_batch(encode_safe, decode_safe);
+
+        test_same_as_generic(encode, decode);
+        test_same_as_generic(encode_unsafe, decode_unsafe);
+        test_same_as_generic(encode_safe, decode_safe);
+
+        test_strict(encode);
+        test_strict(encode_safe);
+
+        test_columnar();
+
+        test_64(encode_safe, decode_safe);
+        test_64(encode, decode);
+        test_64(encode_unsafe, decode_unsafe);
+        test_strict64();
+
+        test_crc32c();
+
+        test_utf8();
+        test_utf8_coder(0);
+        test_utf8_coder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+        test_utf8_coder(BASE16384_FLAG_SUM_CHECK_ON_REMAIN|BASE16384_FLAG_CRC32C);
+        test_utf8_coder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_CRC_TREE);
+    }
+
+    test_calc_sum();
+
+    test_encoder(0);
+    test_encoder(BASE16384_FLAG_NOHEADER);
+    test_encoder(BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+    test_encoder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+
+    test_decoder(0);
+    test_decoder(BASE16384_FLAG_NOHEADER);
+    test_decoder(BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+    test_decoder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+
+    test_decoder_malformed();
 
-    test_batch(encode_unsafe, decode);
-    test_batch(encode_unsafe, decode_unsafe);
-    test_batch(encode_unsafe, decode_safe);
+    test_crc_coder(BASE16384_FLAG_CRC32C);
+    test_crc_coder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_CRC32C);
+    test_crc_coder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY|BASE16384_FLAG_CRC32C);
+    test_crc_coder(BASE16384_FLAG_CRC_TREE);
+    test_crc_coder(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN|BASE16384_FLAG_CRC_TREE);
 
-    test_batch(encode_safe, decode);
-    test_batch(encode_safe, decode_unsafe);
-    test_batch(encode_safe, decode_safe);
+    #ifndef _WIN32
+        test_iov();
+    #endif
     return 0;
 }
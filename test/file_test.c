@@ -16,12 +16,17 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE // splice, F_SETPIPE_SZ
+#endif
+
 #ifdef _WIN32
 	#include <io.h>
     #define ftruncate _chsize_s
 #else
     #define _POSIX1_SOURCE 2
     #include <unistd.h>
+    #include <sys/wait.h>
 #endif
 #include <fcntl.h>
 #include <stdint.h>
@@ -42,6 +47,18 @@
 static char encbuf[BASE16384_ENCBUFSZ];
 static char decbuf[BASE16384_DECBUFSZ];
 static char tstbuf[BASE16384_ENCBUFSZ];
+static char plain[TEST_SIZE*16];
+static char txt[TEST_SIZE*16/7*8+16];
+static char txt2[TEST_SIZE*16/7*8+16];
+static char bin[TEST_SIZE*16+16];
+static char bigplain[_BASE16384_ENCBUFSZ*8];
+static char bigtxt[sizeof(bigplain)/7*8+16];
+static char bigtxt2[sizeof(bigplain)/7*8+16];
+static char bigtxt3[sizeof(bigplain)/7*8+16];
+static char bigbin[sizeof(bigplain)+16];
+static char exencbuf[BASE16384_BUFSZ*3/7*7+16];
+static char exdecbuf[BASE16384_BUFSZ*3/7*8+16];
+static const size_t bufsizes[] = {1, 100, BUFSIZ+3, BASE16384_BUFSZ*3};
 
 #define test_file_detailed(flag) \
     fputs("testing base16384_en/decode_file with flag "#flag"...\n", stderr); \
@@ -91,13 +108,18 @@ static char tstbuf[BASE16384_ENCBUFSZ];
         validate_result(); \
     }
 
+// writes may go at explicit offsets unless the output is appending
 #define test_fd_detailed(flag) \
-    fputs("testing base16384_en/decode_fd with flag "#flag"...\n", stderr); \
+    test_fd_detailed_open(flag, #flag, O_APPEND); \
+    test_fd_detailed_open(flag, #flag, 0);
+
+#define test_fd_detailed_open(flag, flagname, oflag) \
+    fputs("testing base16384_en/decode_fd with flag " flagname " and open flag "#oflag"...\n", stderr); \
     init_input_file(); \
     for(i = TEST_SIZE; i > 0; i--) { \
         reset_and_truncate(fd, i); \
  \
-        int fdout = open(TEST_OUTPUT_FILENAME, O_RDWR|O_TRUNC|O_CREAT|O_APPEND, 0644); \
+        int fdout = open(TEST_OUTPUT_FILENAME, O_RDWR|O_TRUNC|O_CREAT|oflag, 0644); \
         loop_ok(!fdout, i, "open"); \
  \
         err = base16384_encode_fd_detailed(fd, fdout, encbuf, decbuf, flag); \
@@ -157,6 +179,720 @@ static char tstbuf[BASE16384_ENCBUFSZ];
         validate_result(); \
     }
 
+struct counting_stream_t {
+    char* buf;
+    size_t len, pos;
+    int calls;
+    size_t count;   // the count asked by every call, which must never change
+};
+
+// returns short reads like a pipe or a socket does
+static ssize_t counting_reader(const void *client_data, void *buffer, size_t count) {
+    struct counting_stream_t* s = (struct counting_stream_t*)client_data;
+    if(!s->calls++) s->count = count;
+    else if(s->count != count) s->count = 0;
+    size_t n = rand()%4096 + 1;
+    if(n > count) n = count;
+    if(n > s->len - s->pos) n = s->len - s->pos;
+    memcpy(buffer, s->buf + s->pos, n);
+    s->pos += n;
+    return (ssize_t)n;
+}
+
+static ssize_t counting_writer(const void *client_data, const void *buffer, size_t count) {
+    struct counting_stream_t* s = (struct counting_stream_t*)client_data;
+    s->calls++;
+    memcpy(s->buf + s->len, buffer, count);
+    s->len += count;
+    return (ssize_t)count;
+}
+
+// each chunk must cost exactly one read and at most one write
+#define test_stream_calls(method, flag, in, inlen, out) { \
+    struct counting_stream_t r = { .buf = in, .len = inlen }; \
+    struct counting_stream_t w = { .buf = out }; \
+    err = base16384_##method##_stream_detailed(&(base16384_stream_t){ \
+        .client_data = &r, \
+        .f.reader = counting_reader, \
+    }, &(base16384_stream_t){ \
+        .client_data = &w, \
+        .f.writer = counting_writer, \
+    }, encbuf, decbuf, flag); \
+    base16384_loop_ok(err); \
+    if (!r.count || w.calls > r.calls) { \
+        fprintf(stderr, "loop @%d: " #method " took %d reads and %d writes\n", i, r.calls, w.calls); \
+        return 1; \
+    } \
+    out##len = w.len; \
+}
+
+#define test_stream_syscalls(flag) \
+    fputs("testing base16384_en/decode_stream calls with flag "#flag"...\n", stderr); \
+    for(i = 0; i < TEST_SIZE*16; i += rand()%1024+1) { \
+        int j; \
+        for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+        size_t txtlen, binlen; \
+        test_stream_calls(encode, flag, plain, i, txt); \
+        test_stream_calls(decode, flag, txt, txtlen, bin); \
+        if (binlen != (size_t)i || memcmp(plain, bin, i)) { \
+            fprintf(stderr, "loop @%d: stream result mismatch\n", i); \
+            return 1; \
+        } \
+    }
+
+static size_t read_whole_file(const char* name, char* buf, size_t size) {
+    FILE* fp = fopen(name, "rb");
+    if(!fp) return (size_t)-1;
+    size_t n = fread(buf, 1, size, fp);
+    fclose(fp);
+    return n;
+}
+
+// the threaded coding must give the same output as the single threaded one
+#define test_file_parallel(flag) \
+    fputs("testing base16384_en/decode_file_parallel with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*16; i > TEST_SIZE*2; i -= rand()%1024+1) { \
+        int j; \
+        for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(plain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+ \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        size_t txtlen = read_whole_file(TEST_OUTPUT_FILENAME, txt, sizeof(txt)); \
+ \
+        err = base16384_encode_file_parallel(TEST_INPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag, 4); \
+        base16384_loop_ok(err); \
+        if (read_whole_file(TEST_VALIDATE_FILENAME, txt2, sizeof(txt2)) != txtlen || memcmp(txt, txt2, txtlen)) { \
+            fprintf(stderr, "loop @%d: parallel encoding mismatch\n", i); \
+            return 1; \
+        } \
+ \
+        err = base16384_decode_file_parallel(TEST_VALIDATE_FILENAME, TEST_OUTPUT_FILENAME, encbuf, decbuf, flag, 3); \
+        base16384_loop_ok(err); \
+        if (read_whole_file(TEST_OUTPUT_FILENAME, bin, sizeof(bin)) != (size_t)i || memcmp(plain, bin, i)) { \
+            fprintf(stderr, "loop @%d: parallel decoding mismatch\n", i); \
+            return 1; \
+        } \
+    }
+
+// the tree is checked by threads without decoding to a file, and locates the damaged block
+#define test_verify_parallel(flag) \
+    fputs("testing base16384_verify_file_parallel with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*16; i > TEST_SIZE*2; i -= rand()%4096+1) { \
+        int j; \
+        for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(plain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_parallel(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, encbuf, decbuf, flag, 3); \
+        base16384_loop_ok(err); \
+        uint32_t leaves[sizeof(plain)/BASE16384_CRC_TREE_BLOCK+1]; \
+        base16384_crc_tree_leaves(plain, i, leaves); \
+        ssize_t bad; \
+        err = base16384_verify_file_parallel(TEST_OUTPUT_FILENAME, 4, leaves, &bad); \
+        base16384_loop_ok(err); \
+        loop_ok(bad != -1, i, "verify"); \
+        int h = ((flag)&BASE16384_FLAG_NOHEADER)?0:2, victim = rand()%(i/7*8); \
+        size_t txtlen = read_whole_file(TEST_OUTPUT_FILENAME, txt, sizeof(txt)); \
+        txt[h+victim] ^= 0x10; /* a high byte, which always carries data bits */ \
+        victim &= ~1; \
+        fp = fopen(TEST_OUTPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(txt, txtlen, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_verify_file_parallel(TEST_OUTPUT_FILENAME, 4, leaves, &bad); \
+        if (err != base16384_err_invalid_decoding_checksum || bad != victim/(BASE16384_CRC_TREE_BLOCK/7*8)) { \
+            fprintf(stderr, "loop @%d: damage @%d missed, block %d reported\n", i, victim, (int)bad); \
+            return 1; \
+        } \
+    }
+
+// at a block less 1 byte, the units of the remainder end the last block, and only `=` with its offset follow
+#define test_verify_parallel_tail(flag) \
+    fputs("testing base16384_verify_file_parallel at the block boundaries with flag "#flag"...\n", stderr); \
+    for(i = BASE16384_CRC_TREE_BLOCK-1; i <= (int)sizeof(plain); i += BASE16384_CRC_TREE_BLOCK) { \
+        int j; \
+        for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(plain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_parallel(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, encbuf, decbuf, flag, 3); \
+        base16384_loop_ok(err); \
+        uint32_t leaves[sizeof(plain)/BASE16384_CRC_TREE_BLOCK+1]; \
+        base16384_crc_tree_leaves(plain, i, leaves); \
+        ssize_t bad; \
+        err = base16384_verify_file_parallel(TEST_OUTPUT_FILENAME, 4, leaves, &bad); \
+        base16384_loop_ok(err); \
+        loop_ok(bad != -1, i, "verify"); \
+    }
+
+// every range, including those hitting the `=` remainder, equals the same bytes of the data
+#define decode_range_calls(flag) { \
+    int j; \
+    for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+    base16384_encoder_t enc; \
+    base16384_encoder_init(&enc, flag); \
+    int txtlen = base16384_encoder_update(&enc, plain, i, txt); \
+    txtlen += base16384_encoder_final(&enc, txt+txtlen); \
+    fp = fopen(TEST_OUTPUT_FILENAME, "wb"); \
+    loop_ok(!fp, i, "fopen"); \
+    loop_ok(fwrite(txt, txtlen, 1, fp) != 1, i, "fwrite"); \
+    loop_ok(fclose(fp), i, "fclose"); \
+    fd = open(TEST_OUTPUT_FILENAME, O_RDONLY); \
+    loop_ok(fd < 0, i, "open"); \
+    for(j = 0; j < 64; j++) { \
+        int off = (j < 8 && j <= i)?(i-j):(j == 8)?0:rand()%(i+8), len = (j == 8)?i:(j&1)?rand()%16:rand()%(i+1); \
+        int want = (off >= i)?0:((off+len > i)?i-off:len); \
+        ssize_t n = base16384_decode_range(fd, off, len, bin, flag); \
+        if (n != want || memcmp(bin, plain+((off < i)?off:0), want)) { \
+            fprintf(stderr, "loop @%d: range %d+%d decoded %d bytes\n", i, off, len, (int)n); \
+            return 1; \
+        } \
+    } \
+    loop_ok(close(fd), i, "close"); \
+}
+
+// the remainder is also read with exactly a batch of 512 groups left, at 3585~3590 bytes
+#define test_decode_range(flag) \
+    fputs("testing base16384_decode_range with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE; i > 0; i -= rand()%64+1) decode_range_calls(flag) \
+    for(i = 512*7+1; i <= 512*7+6; i++) decode_range_calls(flag)
+
+#define stream_parallel_calls(method, flag, in, inlen, out, threads, depth) { \
+    struct counting_stream_t r = { .buf = in, .len = inlen }; \
+    struct counting_stream_t w = { .buf = out }; \
+    err = base16384_##method##_stream_parallel(&(base16384_stream_t){ \
+        .client_data = &r, \
+        .f.reader = counting_reader, \
+    }, &(base16384_stream_t){ \
+        .client_data = &w, \
+        .f.writer = counting_writer, \
+    }, encbuf, decbuf, flag, threads, depth); \
+    out##len = w.len; \
+}
+
+// the pipelined coding must give the same output as the serial one
+#define test_stream_parallel(flag) \
+    fputs("testing base16384_en/decode_stream_parallel with flag "#flag"...\n", stderr); \
+    for(i = sizeof(bigplain); i > 0; i -= rand()%(TEST_SIZE*16)+1) { \
+        int j; \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        size_t bigtxtlen, bigtxt2len, bigbinlen; \
+        test_stream_calls(encode, flag, bigplain, i, bigtxt); \
+        stream_parallel_calls(encode, flag, bigplain, i, bigtxt2, 3, 4); \
+        base16384_loop_ok(err); \
+        if (bigtxt2len != bigtxtlen || memcmp(bigtxt, bigtxt2, bigtxtlen)) { \
+            fprintf(stderr, "loop @%d: pipelined encoding mismatch\n", i); \
+            return 1; \
+        } \
+        stream_parallel_calls(decode, flag, bigtxt2, bigtxt2len, bigbin, 2, 0); \
+        base16384_loop_ok(err); \
+        if (bigbinlen != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+            fprintf(stderr, "loop @%d: pipelined decoding mismatch\n", i); \
+            return 1; \
+        } \
+        if (do_sum_check(flag) && i%7 && ((flag)&BASE16384_FLAG_DO_SUM_CHECK_FORCELY || i >= _BASE16384_ENCBUFSZ)) { \
+            bigtxt2[bigtxt2len-3] ^= 1; /* the lowest bit in the last unit is a sum bit */ \
+            stream_parallel_calls(decode, flag, bigtxt2, bigtxt2len, bigbin, 2, 0); \
+            if (err != base16384_err_invalid_decoding_checksum) { \
+                fprintf(stderr, "loop @%d: pipelined decoding missed checksum error\n", i); \
+                return 1; \
+            } \
+        } \
+    }
+
+#define stream_parallel_ex_calls(method, flag, in, inlen, out, threads, bufsize) { \
+    struct counting_stream_t r = { .buf = in, .len = inlen }; \
+    struct counting_stream_t w = { .buf = out }; \
+    err = base16384_##method##_stream_parallel_ex(&(base16384_stream_t){ \
+        .client_data = &r, \
+        .f.reader = counting_reader, \
+    }, &(base16384_stream_t){ \
+        .client_data = &w, \
+        .f.writer = counting_writer, \
+    }, encbuf, decbuf, flag, threads, 0, bufsize); \
+    out##len = w.len; \
+}
+
+#define stream_parallel_tail_calls(flag, bufsize) { \
+    size_t bigtxtlen, bigbinlen; \
+    for(d = 0; d < i; d++) bigplain[d] = (char)rand(); \
+    test_stream_calls(encode, flag, bigplain, i, bigtxt); \
+    stream_parallel_ex_calls(decode, flag, bigtxt, bigtxtlen, bigbin, 2, bufsize); \
+    base16384_loop_ok(err); \
+    if (bigbinlen != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+        fprintf(stderr, "loop @%d: pipelined decoding mismatch with bufsize %d\n", i, (int)(bufsize)); \
+        return 1; \
+    } \
+}
+
+// the remainder may straddle two chunks, as at 7/8 of the chunk size less 1, then they must carry it on whole
+#define test_stream_parallel_tail(flag) \
+    fputs("testing base16384_decode_stream_parallel_ex at the chunk boundaries with flag "#flag"...\n", stderr); \
+    for(q = 1; q <= 3; q++) for(i = _BASE16384_DECBUFSZ/8*7*q-10; i <= _BASE16384_DECBUFSZ/8*7*q+10; i++) { \
+        stream_parallel_tail_calls(flag, _BASE16384_DECBUFSZ); \
+    } \
+    for(q = 11; q <= 24; q += 13) for(i = 1; i <= 64; i++) { \
+        stream_parallel_tail_calls(flag, q); \
+    } \
+    i = 2708; \
+    stream_parallel_tail_calls(flag, 11);
+
+#define stream_ex_calls(method, flag, in, inlen, out, bufsize) { \
+    struct counting_stream_t r = { .buf = in, .len = inlen }; \
+    struct counting_stream_t w = { .buf = out }; \
+    err = base16384_##method##_stream_ex(&(base16384_stream_t){ \
+        .client_data = &r, \
+        .f.reader = counting_reader, \
+    }, &(base16384_stream_t){ \
+        .client_data = &w, \
+        .f.writer = counting_writer, \
+    }, exencbuf, exdecbuf, flag, bufsize); \
+    base16384_loop_ok(err); \
+    out##len = w.len; \
+}
+
+#define fd_ex_calls(method, flag, in, out, bufsize) { \
+    int fdi = open(in, O_RDONLY), fdo = open(out, O_WRONLY|O_CREAT|O_TRUNC, 0644); \
+    loop_ok(fdi < 0 || fdo < 0, i, "open"); \
+    err = base16384_##method##_fd_ex(fdi, fdo, exencbuf, exdecbuf, flag, bufsize); \
+    base16384_loop_ok(err); \
+    close(fdi); \
+    close(fdo); \
+}
+
+// any bufsize must give the same output as the default one
+#define test_bufsize(flag) \
+    fputs("testing base16384_en/decode_xxx_ex with flag "#flag"...\n", stderr); \
+    for(i = sizeof(bigplain); i > 0; i -= rand()%(TEST_SIZE*4)+1) { \
+        int j; \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        size_t bigtxtlen, bigtxt3len, bigbinlen; \
+        test_stream_calls(encode, flag, bigplain, i, bigtxt); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(bigplain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        size_t txtlen = read_whole_file(TEST_VALIDATE_FILENAME, bigtxt2, sizeof(bigtxt2)); \
+        for(j = 0; j < (int)(sizeof(bufsizes)/sizeof(bufsizes[0])); j++) { \
+            stream_ex_calls(encode, flag, bigplain, i, bigtxt3, bufsizes[j]); \
+            if (bigtxt3len != bigtxtlen || memcmp(bigtxt, bigtxt3, bigtxtlen)) { \
+                fprintf(stderr, "loop @%d: stream encoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+                return 1; \
+            } \
+            stream_ex_calls(decode, flag, bigtxt, bigtxtlen, bigbin, bufsizes[j]); \
+            if (bigbinlen != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: stream decoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+                return 1; \
+            } \
+            fd_ex_calls(encode, flag, TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, bufsizes[j]); \
+            if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != bigtxtlen || memcmp(bigtxt, bigtxt3, bigtxtlen)) { \
+                fprintf(stderr, "loop @%d: fd encoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+                return 1; \
+            } \
+            err = base16384_encode_file_parallel_ex(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, exencbuf, exdecbuf, flag, 3, bufsizes[j]); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != txtlen || memcmp(bigtxt2, bigtxt3, txtlen)) { \
+                fprintf(stderr, "loop @%d: file encoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+                return 1; \
+            } \
+            err = base16384_decode_file_parallel_ex(TEST_OUTPUT_FILENAME, TEST_VALIDATE_FILENAME, exencbuf, exdecbuf, flag, 3, bufsizes[j]); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_VALIDATE_FILENAME, bigbin, sizeof(bigbin)) != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: file decoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+                return 1; \
+            } \
+        } \
+    }
+
+// files larger than a small bufsize must not be coded at once into buffers of just its size
+#define test_file_small_bufsize(flag) \
+    fputs("testing base16384_en/decode_file_ex with small bufsizes and flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*8; i > 0; i -= rand()%(TEST_SIZE/2)+1) { \
+        static const size_t smallsizes[] = {1, 100, 4096}; \
+        int j; \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(bigplain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        size_t bigtxtlen = read_whole_file(TEST_VALIDATE_FILENAME, bigtxt, sizeof(bigtxt)); \
+        for(j = 0; j < (int)(sizeof(smallsizes)/sizeof(smallsizes[0])); j++) { \
+            char *sencbuf = (char*)malloc(base16384_encbuf_len(smallsizes[j])), *sdecbuf = (char*)malloc(base16384_decbuf_len(smallsizes[j])); \
+            loop_ok(!sencbuf || !sdecbuf, i, "malloc"); \
+            err = base16384_encode_file_ex(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, sencbuf, sdecbuf, flag, smallsizes[j]); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != bigtxtlen || memcmp(bigtxt, bigtxt3, bigtxtlen)) { \
+                fprintf(stderr, "loop @%d: file encoding mismatch with bufsize %d\n", i, (int)smallsizes[j]); \
+                return 1; \
+            } \
+            err = base16384_decode_file_ex(TEST_OUTPUT_FILENAME, TEST_VALIDATE_FILENAME, sencbuf, sdecbuf, flag, smallsizes[j]); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_VALIDATE_FILENAME, bigbin, sizeof(bigbin)) != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: file decoding mismatch with bufsize %d\n", i, (int)smallsizes[j]); \
+                return 1; \
+            } \
+            free(sencbuf); \
+            free(sdecbuf); \
+        } \
+    }
+
+// a big file with a broken remainder must fail before any output is created
+#define test_file_bad_tail(flag) \
+    fputs("testing base16384_decode_file with a bad tail and flag "#flag"...\n", stderr); \
+    for(i = sizeof(bigplain); i >= _BASE16384_DECBUFSZ; i -= rand()%(TEST_SIZE*4)+1) { \
+        int j; \
+        if (!(i%7)) continue; \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(bigplain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        fp = fopen(TEST_OUTPUT_FILENAME, "r+b"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fseek(fp, -1, SEEK_END), i, "fseek"); \
+        loop_ok(fputc(7, fp) == EOF, i, "fputc"); /* no remainder has an offset of 7 */ \
+        loop_ok(fclose(fp), i, "fclose"); \
+        remove(TEST_VALIDATE_FILENAME); \
+        err = base16384_decode_file_detailed(TEST_OUTPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag); \
+        if (err != base16384_err_invalid_decoding_checksum) { \
+            fprintf(stderr, "loop @%d: decoding missed the bad tail\n", i); \
+            return 1; \
+        } \
+        fp = fopen(TEST_VALIDATE_FILENAME, "rb"); \
+        if (fp) { \
+            fprintf(stderr, "loop @%d: output created for the bad tail\n", i); \
+            return 1; \
+        } \
+    }
+
+#ifndef _WIN32
+// split buf of len bytes into up to 16 fragments at random, some of them empty
+static int split_iov(char* buf, size_t len, struct iovec* iov) {
+    int n = rand()%16+1, k;
+    for(k = 0; k < n; k++) {
+        size_t m = (k == n-1)?len:((len && rand()%4)?rand()%(len+1):0);
+        iov[k].iov_base = buf;
+        iov[k].iov_len = m;
+        buf += m;
+        len -= m;
+    }
+    return n;
+}
+
+// the fragments must give the same output as one file of them
+#define test_iov_fd(flag) \
+    fputs("testing base16384_en/decode_iov_fd with flag "#flag"...\n", stderr); \
+    for(i = sizeof(bigplain); i > 0; i -= rand()%(TEST_SIZE*4)+1) { \
+        int j, cnt; \
+        struct iovec iov[16]; \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(bigplain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        size_t txtlen = read_whole_file(TEST_VALIDATE_FILENAME, bigtxt2, sizeof(bigtxt2)); \
+        j = rand()%(sizeof(bufsizes)/sizeof(bufsizes[0])); \
+        cnt = split_iov(bigplain, i, iov); \
+        fd = open(TEST_OUTPUT_FILENAME, O_WRONLY|O_CREAT|O_TRUNC, 0644); \
+        loop_ok(fd < 0, i, "open"); \
+        err = base16384_encode_iov_fd(iov, cnt, fd, exdecbuf, flag, bufsizes[j]); \
+        base16384_loop_ok(err); \
+        close(fd); \
+        if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != txtlen || memcmp(bigtxt2, bigtxt3, txtlen)) { \
+            fprintf(stderr, "loop @%d: iov encoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+            return 1; \
+        } \
+        cnt = split_iov(bigtxt3, txtlen, iov); \
+        fd = open(TEST_OUTPUT_FILENAME, O_WRONLY|O_CREAT|O_TRUNC, 0644); \
+        loop_ok(fd < 0, i, "open"); \
+        err = base16384_decode_iov_fd(iov, cnt, fd, exencbuf, flag, bufsizes[j]); \
+        base16384_loop_ok(err); \
+        close(fd); \
+        if (read_whole_file(TEST_OUTPUT_FILENAME, bigbin, sizeof(bigbin)) != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+            fprintf(stderr, "loop @%d: iov decoding mismatch with bufsize %d\n", i, (int)bufsizes[j]); \
+            return 1; \
+        } \
+    }
+
+static const size_t chunksizes[] = {7, 700, 1003, 0};
+
+// every chunk is decoded alone, and a damaged one is zeroed without touching the others
+#define test_container(flag) \
+    fputs("testing base16384 container with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*16; i >= 0; i -= rand()%(TEST_SIZE*2)+1) { \
+        int j; \
+        size_t chunk = chunksizes[rand()%(sizeof(chunksizes)/sizeof(chunksizes[0]))]; \
+        for(j = 0; j < i; j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(i && fwrite(plain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        fd = open(TEST_INPUT_FILENAME, O_RDONLY); \
+        int fdo = open(TEST_OUTPUT_FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0644); \
+        loop_ok(fd < 0 || fdo < 0, i, "open"); \
+        err = base16384_encode_container(fd, fdo, flag, chunk); \
+        base16384_loop_ok(err); \
+        close(fd); \
+        base16384_container_t c; \
+        loop_ok(base16384_container_open(fdo, &c), i, "base16384_container_open"); \
+        chunk = chunk?chunk/7*7:BASE16384_CONTAINER_CHUNK; /* whole groups */ \
+        if (c.length != (uint64_t)i || c.chunk != chunk || c.count != (i+chunk-1)/chunk) { \
+            fprintf(stderr, "loop @%d: container of %d chunks of %d bytes\n", i, (int)c.count, (int)c.chunk); \
+            return 1; \
+        } \
+        for(j = c.count-1; j >= 0; j--) { \
+            ssize_t n = base16384_container_read_chunk(fdo, &c, j, bin, txt); \
+            if (n < 0 || memcmp(bin, plain+j*chunk, n) || j*chunk+n != ((j+1 < (int)c.count)?(j+1)*chunk:(size_t)i)) { \
+                fprintf(stderr, "loop @%d: container chunk %d mismatch\n", i, j); \
+                return 1; \
+            } \
+        } \
+        int victim = c.count?(int)(rand()%c.count):-1; \
+        if (victim >= 0) { /* flip a high byte of the first group in the chunk */ \
+            char b; \
+            loop_ok(pread(fdo, &b, 1, c.base+c.offsets[victim]) != 1, i, "pread"); \
+            b ^= 0x10; \
+            loop_ok(pwrite(fdo, &b, 1, c.base+c.offsets[victim]) != 1, i, "pwrite"); \
+        } \
+        base16384_container_close(&c); \
+        fd = open(TEST_VALIDATE_FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0644); \
+        loop_ok(fd < 0, i, "open"); \
+        int64_t bad; \
+        int checked = ((flag)&BASE16384_FLAG_CRC32C) && victim >= 0; \
+        err = base16384_decode_container(fdo, fd, 3, &bad); \
+        if (!checked && bad >= 0) checked = 1; /* only a flip out of the alphabet is noticed */ \
+        if (bad != (checked?victim:-1) || err != (checked?base16384_err_invalid_decoding_checksum:base16384_err_ok)) { \
+            fprintf(stderr, "loop @%d: damaged chunk %d reported as %d\n", i, victim, (int)bad); \
+            return 1; \
+        } \
+        close(fd); \
+        close(fdo); \
+        if (read_whole_file(TEST_VALIDATE_FILENAME, bin, sizeof(bin)) != (size_t)i) { \
+            fprintf(stderr, "loop @%d: container decoding length mismatch\n", i); \
+            return 1; \
+        } \
+        for(j = 0; j < i; j++) { \
+            int damaged = (size_t)j/chunk == (size_t)victim; \
+            if (damaged?(checked && bin[j]):(bin[j] != plain[j])) { \
+                fprintf(stderr, "loop @%d: container decoding mismatch @%d\n", i, j); \
+                return 1; \
+            } \
+        } \
+    }
+#endif
+
+struct counting_allocator_t {
+    int allocs, frees;
+};
+
+static void* counting_alloc(void* opaque, size_t size, size_t align) {
+    ((struct counting_allocator_t*)opaque)->allocs++;
+    #ifdef _WIN32
+        return _aligned_malloc(size, align);
+    #else
+        void* p;
+        return posix_memalign(&p, align, size)?NULL:p;
+    #endif
+}
+
+static void counting_free(void* opaque, void* ptr, size_t size) {
+    (void)size;
+    ((struct counting_allocator_t*)opaque)->frees++;
+    #ifdef _WIN32
+        _aligned_free(ptr);
+    #else
+        free(ptr);
+    #endif
+}
+
+#define stream_ctx_calls(method, flag, in, inlen, out, ctx) { \
+    struct counting_stream_t r = { .buf = in, .len = inlen }; \
+    struct counting_stream_t w = { .buf = out }; \
+    err = base16384_##method##_stream_ctx(&(base16384_stream_t){ \
+        .client_data = &r, \
+        .f.reader = counting_reader, \
+    }, &(base16384_stream_t){ \
+        .client_data = &w, \
+        .f.writer = counting_writer, \
+    }, ctx, flag); \
+    base16384_loop_ok(err); \
+    out##len = w.len; \
+}
+
+#define fd_ctx_calls(method, flag, in, out, ctx) { \
+    int fdi = open(in, O_RDONLY), fdo = open(out, O_WRONLY|O_CREAT|O_TRUNC, 0644); \
+    loop_ok(fdi < 0 || fdo < 0, i, "open"); \
+    err = base16384_##method##_fd_ctx(fdi, fdo, ctx, flag); \
+    base16384_loop_ok(err); \
+    close(fdi); \
+    close(fdo); \
+}
+
+// a context of any kind must give the same output as the caller's buffers
+#define test_ctx(flag) \
+    fputs("testing base16384_en/decode_xxx_ctx with flag "#flag"...\n", stderr); \
+    for(i = sizeof(bigplain); i > 0; i -= rand()%TEST_SIZE+1) { \
+        struct counting_allocator_t counter = {0}; \
+        base16384_allocator_t allocator = { counting_alloc, counting_free, &counter }; \
+        base16384_ctx_t ctxs[3]; \
+        int j; \
+        loop_ok(base16384_ctx_init(&ctxs[0], 0, 0, NULL), i, "base16384_ctx_init"); \
+        loop_ok(base16384_ctx_init(&ctxs[1], BUFSIZ+3, BASE16384_CTX_HUGEPAGE, NULL), i, "base16384_ctx_init"); \
+        loop_ok(base16384_ctx_init(&ctxs[2], 100, 0, &allocator), i, "base16384_ctx_init"); \
+        for(j = 0; j < i; j++) bigplain[j] = (char)rand(); \
+        size_t bigtxtlen, bigtxt3len, bigbinlen; \
+        test_stream_calls(encode, flag, bigplain, i, bigtxt); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        loop_ok(fwrite(bigplain, i, 1, fp) != 1, i, "fwrite"); \
+        loop_ok(fclose(fp), i, "fclose"); \
+        err = base16384_encode_file_detailed(TEST_INPUT_FILENAME, TEST_VALIDATE_FILENAME, encbuf, decbuf, flag); \
+        base16384_loop_ok(err); \
+        size_t bigtxt2len = read_whole_file(TEST_VALIDATE_FILENAME, bigtxt2, sizeof(bigtxt2)); \
+        for(j = 0; j < 3; j++) { \
+            if ((uintptr_t)ctxs[j].encbuf%64 || (uintptr_t)ctxs[j].decbuf%64) { \
+                fprintf(stderr, "loop @%d: unaligned buffers of ctx %d\n", i, j); \
+                return 1; \
+            } \
+            stream_ctx_calls(encode, flag, bigplain, i, bigtxt3, &ctxs[j]); \
+            if (bigtxt3len != bigtxtlen || memcmp(bigtxt, bigtxt3, bigtxtlen)) { \
+                fprintf(stderr, "loop @%d: encoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            stream_ctx_calls(decode, flag, bigtxt3, bigtxt3len, bigbin, &ctxs[j]); \
+            if (bigbinlen != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: decoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            fd_ctx_calls(encode, flag, TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, &ctxs[j]); \
+            if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != bigtxtlen || memcmp(bigtxt, bigtxt3, bigtxtlen)) { \
+                fprintf(stderr, "loop @%d: fd encoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            fd_ctx_calls(decode, flag, TEST_OUTPUT_FILENAME, TEST_VALIDATE_FILENAME, &ctxs[j]); \
+            if (read_whole_file(TEST_VALIDATE_FILENAME, bigbin, sizeof(bigbin)) != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: fd decoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            err = base16384_encode_file_ctx(TEST_INPUT_FILENAME, TEST_OUTPUT_FILENAME, &ctxs[j], flag); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_OUTPUT_FILENAME, bigtxt3, sizeof(bigtxt3)) != bigtxt2len || memcmp(bigtxt2, bigtxt3, bigtxt2len)) { \
+                fprintf(stderr, "loop @%d: file encoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            err = base16384_decode_file_ctx(TEST_OUTPUT_FILENAME, TEST_VALIDATE_FILENAME, &ctxs[j], flag); \
+            base16384_loop_ok(err); \
+            if (read_whole_file(TEST_VALIDATE_FILENAME, bigbin, sizeof(bigbin)) != (size_t)i || memcmp(bigplain, bigbin, i)) { \
+                fprintf(stderr, "loop @%d: file decoding mismatch with ctx %d\n", i, j); \
+                return 1; \
+            } \
+            base16384_ctx_free(&ctxs[j]); \
+        } \
+        if (counter.allocs != 1 || counter.frees != 1) { \
+            fprintf(stderr, "loop @%d: allocator called %d times and free %d times\n", i, counter.allocs, counter.frees); \
+            return 1; \
+        } \
+    }
+
+#ifndef _WIN32
+// code in a child process into a pipe, which the splice path takes on linux
+#define fork_coder(method, fdin, fdout, flag, pid) { \
+    pid = fork(); \
+    loop_ok(pid < 0, i, "fork"); \
+    if(!pid) _exit(base16384_##method##_fd_detailed(fdin, fdout, encbuf, decbuf, flag)); \
+    close(fdout); \
+}
+
+// input | encode | decode | validate, with many chunks in flight
+#define test_fd_pipe(flag) \
+    fputs("testing base16384_en/decode_fd into pipes with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*16*8; i > 0; i -= rand()%(TEST_SIZE*16)+1) { \
+        int j, p1[2], p2[2], status; \
+        pid_t enc, dec; \
+        for(j = 0; j < (int)sizeof(plain); j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        for(j = i; j > 0; j -= sizeof(plain)) { \
+            loop_ok(fwrite(plain, (j > (int)sizeof(plain))?sizeof(plain):(size_t)j, 1, fp) != 1, i, "fwrite"); \
+        } \
+        loop_ok(fclose(fp), i, "fclose"); \
+        fd = open(TEST_INPUT_FILENAME, O_RDONLY); \
+        loop_ok(fd < 0, i, "open"); \
+        loop_ok(pipe(p1) || pipe(p2), i, "pipe"); \
+        fork_coder(encode, fd, p1[1], flag, enc); \
+        close(fd); \
+        fork_coder(decode, p1[0], p2[1], flag, dec); \
+        close(p1[0]); \
+        int fdval = open(TEST_VALIDATE_FILENAME, O_WRONLY|O_TRUNC|O_CREAT, 0644); \
+        loop_ok(fdval < 0, i, "open"); \
+        ssize_t n; \
+        while((n = read(p2[0], tstbuf, sizeof(tstbuf))) > 0) { \
+            loop_ok(write(fdval, tstbuf, n) != n, i, "write"); \
+        } \
+        loop_ok(n < 0, i, "read"); \
+        close(p2[0]); \
+        loop_ok(close(fdval), i, "close"); \
+        loop_ok(waitpid(enc, &status, 0) != enc || !WIFEXITED(status) || WEXITSTATUS(status), i, "encode"); \
+        loop_ok(waitpid(dec, &status, 0) != dec || !WIFEXITED(status) || WEXITSTATUS(status), i, "decode"); \
+        validate_result(); \
+    }
+
+#ifdef __linux__
+// input | encode | splice into a pipe read only after the encoder exits | decode | validate
+#define test_fd_pipe_splice(flag) \
+    fputs("testing base16384_encode_fd into a pipe spliced onward with flag "#flag"...\n", stderr); \
+    for(i = TEST_SIZE*16*8; i > 0; i -= rand()%(TEST_SIZE*64)+1) { \
+        int j, p1[2], p2[2], p3[2], status; \
+        pid_t enc, dec; \
+        for(j = 0; j < (int)sizeof(plain); j++) plain[j] = (char)rand(); \
+        fp = fopen(TEST_INPUT_FILENAME, "wb"); \
+        loop_ok(!fp, i, "fopen"); \
+        for(j = i; j > 0; j -= sizeof(plain)) { \
+            loop_ok(fwrite(plain, (j > (int)sizeof(plain))?sizeof(plain):(size_t)j, 1, fp) != 1, i, "fwrite"); \
+        } \
+        loop_ok(fclose(fp), i, "fclose"); \
+        fd = open(TEST_INPUT_FILENAME, O_RDONLY); \
+        loop_ok(fd < 0, i, "open"); \
+        loop_ok(pipe(p1) || pipe(p2) || pipe(p3), i, "pipe"); \
+        loop_ok(fcntl(p3[1], F_SETPIPE_SZ, 1<<20) < (i/7+2)*8, i, "fcntl"); /* holds all the coded pages */ \
+        fork_coder(encode, fd, p1[1], flag, enc); \
+        close(fd); \
+        ssize_t n; \
+        while((n = splice(p1[0], NULL, p3[1], NULL, 1<<20, 0)) > 0); \
+        loop_ok(n < 0, i, "splice"); \
+        close(p1[0]); \
+        close(p3[1]); \
+        loop_ok(waitpid(enc, &status, 0) != enc || !WIFEXITED(status) || WEXITSTATUS(status), i, "encode"); \
+        fork_coder(decode, p3[0], p2[1], flag, dec); \
+        close(p3[0]); \
+        int fdval = open(TEST_VALIDATE_FILENAME, O_WRONLY|O_TRUNC|O_CREAT, 0644); \
+        loop_ok(fdval < 0, i, "open"); \
+        while((n = read(p2[0], tstbuf, sizeof(tstbuf))) > 0) { \
+            loop_ok(write(fdval, tstbuf, n) != n, i, "write"); \
+        } \
+        loop_ok(n < 0, i, "read"); \
+        close(p2[0]); \
+        loop_ok(close(fdval), i, "close"); \
+        loop_ok(waitpid(dec, &status, 0) != dec || !WIFEXITED(status) || WEXITSTATUS(status), i, "decode"); \
+        validate_result(); \
+    }
+#endif
+#endif
+
 #define test_detailed(name) \
     test_##name##_detailed(0); \
 \
@@ -175,7 +911,7 @@ int main() {
     srand(time(NULL));
 
     FILE* fp;
-    int fd, i;
+    int fd, i, q, d;
     base16384_err_t err;
 
     init_test_files();
@@ -185,6 +921,73 @@ int main() {
     test_detailed(fd);
     test_detailed(stream);
 
+    // the test stream writer does not invert the bytes back, so the trailer is checked with the others
+    test_file_detailed(BASE16384_FLAG_CRC32C);
+    test_fp_detailed(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN|BASE16384_FLAG_CRC32C);
+    test_fd_detailed(BASE16384_FLAG_CRC32C);
+    test_file_detailed(BASE16384_FLAG_CRC_TREE);
+
+    test_file_detailed(BASE16384_FLAG_UTF8);
+    test_fp_detailed(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN|BASE16384_FLAG_UTF8);
+    test_fd_detailed(BASE16384_FLAG_DO_SUM_CHECK_FORCELY|BASE16384_FLAG_CRC32C|BASE16384_FLAG_UTF8);
+
+    test_stream_syscalls(0);
+    test_stream_syscalls(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+
+    test_decode_range(0);
+    test_decode_range(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+    test_decode_range(BASE16384_FLAG_CRC32C);
+
+    test_file_parallel(0);
+    test_file_parallel(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+    test_file_parallel(BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+    test_file_parallel(BASE16384_FLAG_CRC32C);
+    test_file_parallel(BASE16384_FLAG_CRC_TREE);
+    test_file_parallel(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN|BASE16384_FLAG_CRC_TREE);
+
+    test_stream_parallel(0);
+    test_stream_parallel(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+    test_stream_parallel(BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+    test_stream_parallel_tail(0);
+    test_stream_parallel_tail(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+
+    test_bufsize(0);
+    test_bufsize(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+    test_bufsize(BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+    test_bufsize(BASE16384_FLAG_CRC32C);
+
+    test_file_small_bufsize(0);
+    test_file_small_bufsize(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+
+    #ifndef _WIN32
+        test_file_bad_tail(0);
+        test_file_bad_tail(BASE16384_FLAG_NOHEADER);
+    #endif
+
+    test_ctx(0);
+    test_ctx(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+
+    #ifndef _WIN32
+        test_fd_pipe(0);
+        test_fd_pipe(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+        #ifdef __linux__
+            test_fd_pipe_splice(0);
+            test_fd_pipe_splice(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+        #endif
+
+        test_iov_fd(0);
+        test_iov_fd(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_SUM_CHECK_ON_REMAIN);
+        test_iov_fd(BASE16384_FLAG_DO_SUM_CHECK_FORCELY);
+        test_iov_fd(BASE16384_FLAG_CRC32C);
+
+        test_verify_parallel(BASE16384_FLAG_CRC_TREE);
+        test_verify_parallel(BASE16384_FLAG_NOHEADER|BASE16384_FLAG_CRC_TREE);
+        test_verify_parallel_tail(BASE16384_FLAG_CRC_TREE);
+
+        test_container(BASE16384_FLAG_CRC32C);
+        test_container(BASE16384_FLAG_NOHEADER);
+    #endif
+
     remove_test_files();
 
     return 0;
@@ -0,0 +1,328 @@
+/* uring.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+#include "uring.h"
+
+#ifdef BASE16384_URING
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#ifdef IORING_FEAT_RW_CUR_POS
+
+/*
+ * A minimal io_uring driven by the raw syscalls, so that neither liburing
+ * nor a new libc is needed. There is only one submitter and one reaper.
+*/
+
+struct base16384_uring_t {
+	int fd;
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_size, cq_size, sqes_size;
+	int fixed;	// the buffers are registered
+};
+typedef struct base16384_uring_t base16384_uring_t;
+
+#define URING_SLOTS (4)
+#define URING_MIN_CHUNKS (URING_SLOTS*2)	// the least chunks left in a regular file to set up a ring for
+
+static int uring_init(base16384_uring_t* r) {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	memset(r, 0, sizeof(*r));
+	r->fd = (int)syscall(__NR_io_uring_setup, URING_SLOTS*2, &p);
+	if(r->fd < 0) return -1;
+	// reads and writes at the current file position are needed for pipes
+	if(!(p.features&IORING_FEAT_RW_CUR_POS)) {
+		close(r->fd);
+		return -1;
+	}
+	r->sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	r->cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if(p.features&IORING_FEAT_SINGLE_MMAP) {
+		if(r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+		r->cq_size = r->sq_size;
+	}
+	r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if(r->sq_ptr == MAP_FAILED) goto uring_init_error;
+	if(p.features&IORING_FEAT_SINGLE_MMAP) r->cq_ptr = r->sq_ptr;
+	else {
+		r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if(r->cq_ptr == MAP_FAILED) {
+			munmap(r->sq_ptr, r->sq_size);
+			goto uring_init_error;
+		}
+	}
+	r->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+	r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if(r->sqes == MAP_FAILED) {
+		if(r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+		munmap(r->sq_ptr, r->sq_size);
+		goto uring_init_error;
+	}
+	r->sq_tail = (unsigned*)((char*)r->sq_ptr + p.sq_off.tail);
+	r->sq_mask = (unsigned*)((char*)r->sq_ptr + p.sq_off.ring_mask);
+	r->sq_array = (unsigned*)((char*)r->sq_ptr + p.sq_off.array);
+	r->cq_head = (unsigned*)((char*)r->cq_ptr + p.cq_off.head);
+	r->cq_tail = (unsigned*)((char*)r->cq_ptr + p.cq_off.tail);
+	r->cq_mask = (unsigned*)((char*)r->cq_ptr + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe*)((char*)r->cq_ptr + p.cq_off.cqes);
+	return 0;
+uring_init_error:
+	close(r->fd);
+	return -1;
+}
+
+static void uring_exit(base16384_uring_t* r) {
+	munmap(r->sqes, r->sqes_size);
+	if(r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+	munmap(r->sq_ptr, r->sq_size);
+	close(r->fd);
+}
+
+// queue one read or write and submit it at once
+static int uring_submit(base16384_uring_t* r, int op, int fd, char* buf, unsigned len, off_t off, uint64_t user_data) {
+	unsigned tail = *r->sq_tail, idx = tail & *r->sq_mask;
+	struct io_uring_sqe* sqe = &r->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = r->fixed?((op == IORING_OP_READ)?IORING_OP_READ_FIXED:IORING_OP_WRITE_FIXED):op;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = (uint64_t)off;	// -1 for the current position
+	sqe->buf_index = 0;
+	sqe->user_data = user_data;
+	r->sq_array[idx] = idx;
+	__atomic_store_n(r->sq_tail, tail+1, __ATOMIC_RELEASE);
+	int ret;
+	while((ret = (int)syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR);
+	return (ret == 1)?0:-1;
+}
+
+// wait for one completion
+static int uring_reap(base16384_uring_t* r, uint64_t* user_data, int* res) {
+	unsigned head = *r->cq_head;
+	while(head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+		if(syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) return -1;
+	}
+	struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+	*user_data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(r->cq_head, head+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+struct base16384_uring_slot_t {
+	char *in, *out;
+	int reading;
+	int rlen;		// the read result
+	int writing;
+	int wlen, wdone;	// bytes to write and written
+	off_t woff;		// -1 for the current position
+};
+typedef struct base16384_uring_slot_t base16384_uring_slot_t;
+
+#define slot_data(i, is_write) ((uint64_t)(i)<<1 | (is_write))
+
+// handle one completion, resubmitting the rest of a short write
+static int uring_handle(base16384_uring_t* r, base16384_uring_slot_t* slots, int output, int* writes, int* werr) {
+	uint64_t user_data;
+	int res;
+	if(uring_reap(r, &user_data, &res)) return -1;
+	base16384_uring_slot_t* s = &slots[user_data>>1];
+	if(!(user_data&1)) {
+		s->reading = 0;
+		s->rlen = res;
+		return 0;
+	}
+	if(res > 0 && (s->wdone += res) < s->wlen) {
+		off_t off = (s->woff < 0)?-1:s->woff+s->wdone;
+		if(!uring_submit(r, IORING_OP_WRITE, output, s->out+s->wdone, s->wlen-s->wdone, off, user_data)) return 0;
+		res = -errno;
+	}
+	if(res <= 0 && !*werr) *werr = res?-res:EIO;
+	s->writing = 0;
+	(*writes)--;
+	return 0;
+}
+
+#define handle_one() if(uring_handle(&r, slots, output, &writes, &werr)) { \
+	*err = base16384_err_read_file; \
+	goto base16384_code_fd_uring_cleanup; \
+}
+
+/*
+ * Slot k holds chunk k in a ring of URING_SLOTS. While chunk k is being
+ * coded, the read of chunk k+1 and the writes of the chunks before k are
+ * in flight. Reads always use the current position, so there is only one
+ * of them at a time and pipes work. Writes use explicit offsets when the
+ * output is seekable and not appending, or else also go one at a time.
+*/
+static int code_fd_uring(int input, int output, size_t bufsize, int flag, int is_encode, base16384_err_t* err) {
+	base16384_uring_t r;
+	struct stat st;
+	unsigned readsize = read_chunk_size(bufsize, is_encode?7:8);
+	// the ring and its registered slots take hundreds of microseconds to set up, far more than a small file to code
+	if(!fstat(input, &st) && S_ISREG(st.st_mode) && st.st_size - lseek(input, 0, SEEK_CUR) < (off_t)URING_MIN_CHUNKS*readsize) return -1;
+	if(uring_init(&r)) return -1;
+	// both encbuf and decbuf fit in, and the UTF-8 of BASE16384_FLAG_UTF8 too
+	size_t halfsize = base16384_decbuf_len((is_encode && is_utf8(flag))?readsize/2*3:readsize), slotsize = halfsize*2;
+	char* bufs;
+	if(posix_memalign((void**)&bufs, 4096, slotsize*URING_SLOTS)) {
+		uring_exit(&r);
+		return -1;
+	}
+	// registering may fail on a low RLIMIT_MEMLOCK, then normal reads and writes are used
+	struct iovec iov = { .iov_base = bufs, .iov_len = slotsize*URING_SLOTS };
+	r.fixed = !syscall(__NR_io_uring_register, r.fd, IORING_REGISTER_BUFFERS, &iov, 1);
+
+	base16384_uring_slot_t slots[URING_SLOTS];
+	int i;
+	for(i = 0; i < URING_SLOTS; i++) {
+		memset(&slots[i], 0, sizeof(slots[i]));
+		slots[i].in = bufs + i*slotsize;
+		slots[i].out = slots[i].in + halfsize;
+	}
+	off_t outoff = lseek(output, 0, SEEK_CUR);
+	int seekable = outoff >= 0 && !(fcntl(output, F_GETFL)&O_APPEND);
+	int writes = 0, werr = 0, n;
+	base16384_encoder_t enc;
+	base16384_decoder_t dec;
+	if(is_encode) base16384_encoder_init(&enc, flag);
+	else base16384_decoder_init(&dec, flag);
+	*err = base16384_err_ok;
+
+	unsigned k = 0;
+	slots[0].reading = 1;
+	if(uring_submit(&r, IORING_OP_READ, input, slots[0].in, readsize, -1, slot_data(0, 0))) {
+		*err = base16384_err_read_file;
+		goto base16384_code_fd_uring_cleanup;
+	}
+	for(;; k++) {
+		base16384_uring_slot_t *s = &slots[k%URING_SLOTS], *next = &slots[(k+1)%URING_SLOTS];
+		while(s->reading) handle_one();
+		if(s->rlen < 0) {
+			errno = -s->rlen;
+			*err = base16384_err_read_file;
+			goto base16384_code_fd_uring_cleanup;
+		}
+		if(!s->rlen) break;
+		while(next->writing) handle_one();
+		next->reading = 1;
+		if(uring_submit(&r, IORING_OP_READ, input, next->in, readsize, -1, slot_data((k+1)%URING_SLOTS, 0))) {
+			next->reading = 0;
+			*err = base16384_err_read_file;
+			goto base16384_code_fd_uring_cleanup;
+		}
+		n = is_encode
+			?base16384_encoder_update(&enc, s->in, s->rlen, s->out)
+			:base16384_decoder_update(&dec, s->in, s->rlen, s->out);
+		if(!n) continue;
+		if(!seekable) while(writes) handle_one();
+		if(werr) break;
+		s->wlen = n;
+		s->wdone = 0;
+		s->woff = seekable?outoff:-1;
+		s->writing = 1;
+		writes++;
+		if(uring_submit(&r, IORING_OP_WRITE, output, s->out, n, s->woff, slot_data(k%URING_SLOTS, 1))) {
+			s->writing = 0;
+			writes--;
+			werr = errno;
+			break;
+		}
+		if(seekable) outoff += n;
+	}
+	while(writes) handle_one();
+	if(werr) {
+		errno = werr;
+		*err = base16384_err_write_file;
+		goto base16384_code_fd_uring_cleanup;
+	}
+	// explicit offsets leave the position untouched
+	if(seekable && lseek(output, outoff, SEEK_SET) < 0) {
+		*err = base16384_err_write_file;
+		goto base16384_code_fd_uring_cleanup;
+	}
+	if(is_encode) n = base16384_encoder_final(&enc, slots[0].out);
+	else if((n = base16384_decoder_final(&dec, slots[0].out)) < 0) {
+		*err = base16384_err_invalid_decoding_checksum;
+		goto base16384_code_fd_uring_cleanup;
+	}
+	if(n && write(output, slots[0].out, n) != n) {
+		*err = base16384_err_write_file;
+	}
+base16384_code_fd_uring_cleanup:
+	// never free buffers still used by the kernel
+	for(i = 0; i < URING_SLOTS; i++) {
+		uint64_t user_data;
+		int res;
+		while((slots[i].reading || slots[i].writing) && !uring_reap(&r, &user_data, &res)) {
+			if(user_data&1) slots[user_data>>1].writing = 0;
+			else slots[user_data>>1].reading = 0;
+		}
+	}
+	int errnobak = errno;
+	uring_exit(&r);
+	free(bufs);
+	errno = errnobak;
+	return 0;
+}
+
+#undef handle_one
+#undef slot_data
+
+int _base16384_encode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err) {
+	return code_fd_uring(input, output, bufsize, flag, 1, err);
+}
+
+int _base16384_decode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err) {
+	return code_fd_uring(input, output, bufsize, flag, 0, err);
+}
+
+#else
+
+int _base16384_encode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err) {
+	return -1;
+}
+
+int _base16384_decode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err) {
+	return -1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+/* uring.h
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__linux__) && !defined(__cosmopolitan) && defined(__has_include)
+	#if __has_include(<linux/io_uring.h>)
+		#define BASE16384_URING
+	#endif
+#endif
+
+#ifdef BASE16384_URING
+
+/**
+ * @brief encode input fd to output fd through io_uring, overlapping the read
+ *        of the next chunk and the writes of the last chunks with encoding
+ * @param input file descripter
+ * @param output file descripter
+ * @param bufsize the bytes read at a time
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param err where to put the error code
+ * @return 0 if done or -1 if io_uring is unavailable or not worth it for a small file, and nothing is touched
+*/
+int _base16384_encode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err);
+
+/**
+ * @brief decode input fd to output fd through io_uring, overlapping the read
+ *        of the next chunk and the writes of the last chunks with decoding
+ * @param input file descripter
+ * @param output file descripter
+ * @param bufsize the bytes read at a time
+ * @param flag BASE16384_FLAG_xxx value, add multiple flags by `|`
+ * @param err where to put the error code
+ * @return 0 if done or -1 if io_uring is unavailable or not worth it for a small file, and nothing is touched
+*/
+int _base16384_decode_fd_uring(int input, int output, size_t bufsize, int flag, base16384_err_t* err);
+
+#endif
+
+#endif
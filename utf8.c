@@ -0,0 +1,58 @@
+/* utf8.c
+ * This file is part of the base16384 distribution (https://github.com/fumiama/base16384).
+ * Copyright (c) 2022-2025 Fumiama Minamoto.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __cosmopolitan
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+#include "base16384.h"
+#include "binary.h"
+#include "simd.h"
+
+/*
+ * The kernels write the UTF-8 of the code units straight from registers.
+ * Whatever they leave, including the `=` remainder, goes through UTF-16BE
+ * in blocks small enough to stay in L1, which also covers the generic impl.
+*/
+
+#define UTF8_BLOCK_GROUPS (512)	// 3.5 KiB of data, 4 KiB of UTF-16BE and 6 KiB of UTF-8
+
+int base16384_encode_utf8(const char* data, int dlen, char* buf) {
+	char code[UTF8_BLOCK_GROUPS*8+16];
+	int i = (int)_base16384_encode_utf8_simd(data, dlen/7, buf)*7, n = i/7*12, m;
+	for(; i < dlen; i += m) {
+		m = (dlen - i > UTF8_BLOCK_GROUPS*7)?UTF8_BLOCK_GROUPS*7:dlen-i;
+		n += utf16_to_utf8(code, base16384_encode_safe(data+i, m, code), buf+n);
+	}
+	return n;
+}
+
+int base16384_decode_utf8(const char* data, int dlen, char* buf) {
+	char code[UTF8_BLOCK_GROUPS*8+16];
+	int units = dlen/3, m;
+	// an underfilled group and its `=` remainder take 2 to 5 units, which the kernel always leaves
+	int i = (units > 2)?(int)_base16384_decode_utf8_simd(data, (units-2)/4, buf)*4:0, n = i/4*7;
+	for(units -= i; units; units -= m, i += m) {
+		// the `=` remainder is never split from its group
+		m = (units > UTF8_BLOCK_GROUPS*4+5)?UTF8_BLOCK_GROUPS*4:units;
+		n += base16384_decode_safe(code, utf8_to_utf16(data+i*3, m*3, code), buf+n);
+	}
+	return n;
+}
@@ -17,6 +17,7 @@
  */
 
 #include "base16384.h"
+#include "simd.h"
 
 #define base16384_typed_params(type) type input, type output, char* encbuf, char* decbuf
 
@@ -37,4 +38,115 @@
 
 #undef BASE16384_WRAP_DECL
 
+#define BASE16384_WRAP_DECL(method, name, type) \
+	base16384_err_t base16384_##method##_##name##_detailed(base16384_typed_params(type), int flag) { \
+		return base16384_##method##_##name##_ex(input, output, encbuf, decbuf, flag, BASE16384_BUFSZ); \
+	}
+
+	BASE16384_WRAP_DECL(encode, file, const char*);
+	BASE16384_WRAP_DECL(encode, fp, FILE*);
+	BASE16384_WRAP_DECL(encode, fd, int);
+	BASE16384_WRAP_DECL(encode, stream, base16384_stream_t*);
+
+	BASE16384_WRAP_DECL(decode, file, const char*);
+	BASE16384_WRAP_DECL(decode, fp, FILE*);
+	BASE16384_WRAP_DECL(decode, fd, int);
+	BASE16384_WRAP_DECL(decode, stream, base16384_stream_t*);
+
+#undef BASE16384_WRAP_DECL
+
+#define BASE16384_CTX_DECL(method, name, type) \
+	base16384_err_t base16384_##method##_##name##_ctx(type input, type output, base16384_ctx_t* ctx, int flag) { \
+		return base16384_##method##_##name##_ex(input, output, ctx->encbuf, ctx->decbuf, flag, ctx->bufsize); \
+	}
+
+	BASE16384_CTX_DECL(encode, file, const char*);
+	BASE16384_CTX_DECL(encode, fp, FILE*);
+	BASE16384_CTX_DECL(encode, stream, base16384_stream_t*);
+
+	BASE16384_CTX_DECL(decode, file, const char*);
+	BASE16384_CTX_DECL(decode, fp, FILE*);
+	BASE16384_CTX_DECL(decode, stream, base16384_stream_t*);
+
+#undef BASE16384_CTX_DECL
+
 #undef base16384_typed_params
+
+#define is_valid_unit(p) ((uint8_t)((uint8_t)(p)[0] - 0x4e) < 0x40)
+#define is_valid_group(p) ((uint8_t)( \
+	(uint8_t)((uint8_t)(p)[0] - 0x4e) | (uint8_t)((uint8_t)(p)[2] - 0x4e) | \
+	(uint8_t)((uint8_t)(p)[4] - 0x4e) | (uint8_t)((uint8_t)(p)[6] - 0x4e) \
+) < 0x40)
+
+int base16384_decode_strict(const char* data, int dlen, char* buf, int* errpos) {
+	int end = dlen, i;
+	if(dlen%2) {
+		i = dlen - 1;
+		goto base16384_decode_strict_error;
+	}
+	if(dlen >= 2 && data[dlen-2] == '=') {
+		int offset = data[dlen-1];
+		end -= 2;
+		// the underfilled group takes offset/2+1 code units
+		if(offset < 1 || offset > 6 || end%8 != (offset/2+1)*2%8) {
+			i = end;
+			goto base16384_decode_strict_error;
+		}
+	} else if(dlen%8) {
+		i = dlen/8*8;
+		goto base16384_decode_strict_error;
+	}
+	if(!dlen) return 0;
+	int n = (int)_base16384_decode_strict_simd(data, end/8, buf);
+	for(i = n*8; i + 8 <= end && is_valid_group(data+i); i += 8);
+	for(; i < end; i += 2) {
+		if(!is_valid_unit(data+i)) goto base16384_decode_strict_error;
+	}
+	return n*7 + base16384_decode_safe(data+n*8, dlen-n*8, buf+n*7);
+base16384_decode_strict_error:
+	if(errpos) *errpos = i;
+	return -1;
+}
+
+#ifndef BASE16384_CHUNK64_BYTES
+	#define BASE16384_CHUNK64_BYTES ((size_t)1<<30)
+#endif
+
+// whole groups given to one kernel call, leaving the remainder and its `=` tail to the last one
+#define CHUNK64(unit) ((size_t)BASE16384_CHUNK64_BYTES/(unit)*(unit))
+
+#define BASE16384_WRAP64_DECL(method, variant, unit) \
+	size_t base16384_##method##variant##64(const char* data, size_t dlen, char* buf) { \
+		size_t n = 0; \
+		while(dlen > CHUNK64(unit) + 16) { \
+			n += (size_t)base16384_##method##variant(data, (int)CHUNK64(unit), buf+n); \
+			data += CHUNK64(unit); \
+			dlen -= CHUNK64(unit); \
+		} \
+		return n + (size_t)base16384_##method##variant(data, (int)dlen, buf+n); \
+	}
+
+	BASE16384_WRAP64_DECL(encode, _safe, 7);
+	BASE16384_WRAP64_DECL(encode, , 7);
+	BASE16384_WRAP64_DECL(encode, _unsafe, 7);
+
+	BASE16384_WRAP64_DECL(decode, _safe, 8);
+	BASE16384_WRAP64_DECL(decode, , 8);
+	BASE16384_WRAP64_DECL(decode, _unsafe, 8);
+
+#undef BASE16384_WRAP64_DECL
+
+ssize_t base16384_decode_strict64(const char* data, size_t dlen, char* buf, size_t* errpos) {
+	size_t n = 0, done = 0;
+	int m, pos;
+	while(dlen - done > CHUNK64(8) + 16) {
+		if((m = base16384_decode_strict(data+done, (int)CHUNK64(8), buf+n, &pos)) < 0) goto base16384_decode_strict64_error;
+		n += m;
+		done += CHUNK64(8);
+	}
+	if((m = base16384_decode_strict(data+done, (int)(dlen-done), buf+n, &pos)) < 0) goto base16384_decode_strict64_error;
+	return (ssize_t)(n + m);
+base16384_decode_strict64_error:
+	if(errpos) *errpos = done + pos;
+	return -1;
+}